@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace speedr {
+
+// Appends values to a byte string in native byte order, for files that are
+// read back by the same machine or that record their byte order.
+class ByteWriter {
+public:
+	template <typename T>
+	void Write(const T& value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		bytes_.append(reinterpret_cast<const char*>(&value), sizeof value);
+	}
+	template <typename T>
+	void WriteArray(const std::vector<T>& values) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		bytes_.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+	void WriteBytes(const std::string& bytes) {
+		bytes_ += bytes;
+	}
+
+	const std::string& bytes() const { return bytes_; }
+
+private:
+	std::string bytes_;
+};
+
+// Reads back what a ByteWriter wrote. Each read fails, leaving the reader at
+// the end, if fewer bytes are left than it needs.
+class ByteReader {
+public:
+	ByteReader(const char* data, const std::size_t size) : data_(data), size_left_(size) {}
+	explicit ByteReader(const std::string& bytes) : ByteReader(bytes.data(), bytes.size()) {}
+
+	template <typename T>
+	bool Read(T& value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		return ReadBytes(&value, sizeof value);
+	}
+	template <typename T>
+	bool ReadArray(std::vector<T>& values, const std::size_t count) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		if (count > size_left_ / sizeof(T)) return Fail();
+		values.resize(count);
+		return ReadBytes(values.data(), count * sizeof(T));
+	}
+
+	std::size_t size_left() const { return size_left_; }
+
+private:
+	bool ReadBytes(void* destination, const std::size_t size) {
+		if (size > size_left_) return Fail();
+		std::memcpy(destination, data_, size);
+		data_ += size;
+		size_left_ -= size;
+		return true;
+	}
+	bool Fail() {
+		data_ += size_left_;
+		size_left_ = 0;
+		return false;
+	}
+
+	const char* data_;
+	std::size_t size_left_;
+};
+
+}
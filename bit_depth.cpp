@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bit_depth.h"
+
+#include <numeric>
+
+namespace speedr {
+
+std::optional<BitDepth> FindBitDepth(const BlockStatistics& statistics, const std::uint64_t frames) {
+	if (statistics.bits.empty()) return std::nullopt;
+	std::uint32_t bits = 0;
+	for (const std::vector<std::uint32_t>& channel_bits: statistics.bits) {
+		for (const std::uint32_t block_bits: channel_bits) {
+			bits |= block_bits;
+		}
+	}
+	BitDepth bit_depth;
+	bit_depth.effective_bits = 32;
+	while (bit_depth.effective_bits > 0 && !(bits >> (32 - bit_depth.effective_bits) & 1)) {
+		--bit_depth.effective_bits;
+	}
+	for (const std::vector<double>& channel_sum: statistics.sum) {
+		const double sum = std::accumulate(channel_sum.begin(), channel_sum.end(), 0.);
+		bit_depth.dc_offsets.push_back(frames > 0 ? sum / frames : 0);
+	}
+	return bit_depth;
+}
+
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "compute_dr.h"
+
+namespace speedr {
+
+struct BitDepth {
+	// Bits down to the lowest one set in any sample, e.g. 16 for 16-bit audio
+	// padded to 24 bits, or 0 for digital silence.
+	int effective_bits;
+	// Mean of each channel, relative to full scale.
+	std::vector<double> dc_offsets;
+};
+
+// From the bits and sums of the blocks of a track of `frames` frames, or
+// nothing if its samples were not read as integers.
+std::optional<BitDepth> FindBitDepth(const BlockStatistics& statistics, std::uint64_t frames);
+
+}
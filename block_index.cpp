@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "block_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace speedr {
+
+namespace {
+
+// Enough bits for the ranks of `num_blocks` blocks.
+std::size_t NumLevels(const std::size_t num_blocks) {
+	std::size_t num_levels = 0;
+	while (num_levels < 32 && (std::size_t{1} << num_levels) < num_blocks) {
+		++num_levels;
+	}
+	return num_levels;
+}
+
+void InsertPeak(const float peak, float& largest, float& second_largest) {
+	if (peak > largest) {
+		second_largest = largest;
+		largest = peak;
+	}
+	else if (peak > second_largest) {
+		second_largest = peak;
+	}
+}
+
+}
+
+BlockIndex::BlockIndex(const BlockStatistics& statistics)
+	: num_blocks_(statistics.mean_square.empty() ? 0 : statistics.mean_square[0].size()),
+	  num_levels_(NumLevels(num_blocks_)),
+	  channels_(statistics.mean_square.size()) {
+	const std::size_t n = num_blocks_;
+	for (std::size_t c = 0; c < channels_.size(); ++c) {
+		const std::vector<float>& mean_square = statistics.mean_square[c];
+		const std::vector<float>& peak = statistics.peak[c];
+		ChannelIndex& channel = channels_[c];
+
+		std::vector<std::uint32_t> blocks(n);
+		std::iota(blocks.begin(), blocks.end(), 0);
+		std::stable_sort(blocks.begin(), blocks.end(), [&mean_square](const std::uint32_t a, const std::uint32_t b) { return mean_square[a] < mean_square[b]; });
+		std::vector<std::uint32_t> rank(n);
+		for (std::size_t i = 0; i < n; ++i) {
+			rank[blocks[i]] = i;
+		}
+		std::iota(blocks.begin(), blocks.end(), 0);
+
+		channel.ones.resize(num_levels_ * (n + 1));
+		channel.zeros.resize(num_levels_);
+		channel.sums.resize((num_levels_ + 1) * (n + 1));
+		for (std::size_t level = 0; level <= num_levels_; ++level) {
+			double* const sums = &channel.sums[level * (n + 1)];
+			sums[0] = 0;
+			for (std::size_t i = 0; i < n; ++i) {
+				sums[i + 1] = sums[i] + mean_square[blocks[i]];
+			}
+			if (level == num_levels_) break;
+
+			const std::size_t shift = num_levels_ - 1 - level;
+			const auto bit = [&rank, shift](const std::uint32_t block) { return (rank[block] >> shift) & 1; };
+			std::uint32_t* const ones = &channel.ones[level * (n + 1)];
+			ones[0] = 0;
+			for (std::size_t i = 0; i < n; ++i) {
+				ones[i + 1] = ones[i] + bit(blocks[i]);
+			}
+			channel.zeros[level] = n - ones[n];
+			std::stable_partition(blocks.begin(), blocks.end(), [&bit](const std::uint32_t block) { return bit(block) == 0; });
+		}
+
+		constexpr float kNone = -std::numeric_limits<float>::infinity();
+		channel.peaks.assign(4 * n, kNone);
+		for (std::size_t i = 0; i < n; ++i) {
+			channel.peaks[2 * (n + i)] = peak[i];
+		}
+		for (std::size_t node = n; node-- > 1;) {
+			float* const peaks = &channel.peaks[2 * node];
+			for (std::size_t child = 2 * node; child <= 2 * node + 1; ++child) {
+				InsertPeak(channel.peaks[2 * child], peaks[0], peaks[1]);
+				InsertPeak(channel.peaks[2 * child + 1], peaks[0], peaks[1]);
+			}
+		}
+	}
+}
+
+double BlockIndex::ChannelIndex::SumLargestMeanSquares(std::size_t first_block, std::size_t end_block, std::size_t count, const std::size_t num_blocks) const {
+	const std::size_t stride = num_blocks + 1;
+	double sum = 0;
+	for (std::size_t level = 0; level < zeros.size(); ++level) {
+		const std::uint32_t* const level_ones = &ones[level * stride];
+		const std::size_t first_one = zeros[level] + level_ones[first_block];
+		const std::size_t end_one = zeros[level] + level_ones[end_block];
+		const std::size_t num_ones = end_one - first_one;
+		if (count <= num_ones) {
+			first_block = first_one;
+			end_block = end_one;
+		}
+		else {
+			// All of the larger half is taken, and the rest is looked for among
+			// the smaller one.
+			const double* const next_sums = &sums[(level + 1) * stride];
+			sum += next_sums[end_one] - next_sums[first_one];
+			count -= num_ones;
+			first_block -= level_ones[first_block];
+			end_block -= level_ones[end_block];
+		}
+	}
+	const double* const final_sums = &sums[zeros.size() * stride];
+	return sum + (final_sums[first_block + count] - final_sums[first_block]);
+}
+
+float BlockIndex::ChannelIndex::SecondLargestPeak(std::size_t first_block, std::size_t end_block, const std::size_t num_blocks) const {
+	float largest = -std::numeric_limits<float>::infinity();
+	float second_largest = largest;
+	for (first_block += num_blocks, end_block += num_blocks; first_block < end_block; first_block /= 2, end_block /= 2) {
+		if (first_block % 2 == 1) {
+			InsertPeak(peaks[2 * first_block], largest, second_largest);
+			InsertPeak(peaks[2 * first_block + 1], largest, second_largest);
+			++first_block;
+		}
+		if (end_block % 2 == 1) {
+			--end_block;
+			InsertPeak(peaks[2 * end_block], largest, second_largest);
+			InsertPeak(peaks[2 * end_block + 1], largest, second_largest);
+		}
+	}
+	// A single block is rated on its own peak.
+	return std::isinf(second_largest) ? largest : second_largest;
+}
+
+Rating BlockIndex::Rate(const std::size_t first_block, const std::size_t end_block) const {
+	const auto num_top_blocks = std::max<std::size_t>(1, (end_block - first_block) / 5);
+	std::vector<float> ratings;
+	ratings.reserve(channels_.size());
+	for (const ChannelIndex& channel: channels_) {
+		// The doubling corresponds to AES17 calibration (+3dB)
+		const float average_mean_square = static_cast<float>(channel.SumLargestMeanSquares(first_block, end_block, num_top_blocks, num_blocks_)) * 2.f / num_top_blocks;
+		const float peak = channel.SecondLargestPeak(first_block, end_block, num_blocks_);
+		ratings.push_back(10 * std::log10(peak * peak / average_mean_square));
+	}
+	return Rating::FromChannelRatings(std::move(ratings));
+}
+
+void BlockIndex::Serialize(ByteWriter& writer) const {
+	for (const ChannelIndex& channel: channels_) {
+		writer.WriteArray(channel.ones);
+		writer.WriteArray(channel.zeros);
+		writer.WriteArray(channel.sums);
+		writer.WriteArray(channel.peaks);
+	}
+}
+
+std::optional<BlockIndex> BlockIndex::Deserialize(ByteReader& reader, const std::size_t num_channels, const std::size_t num_blocks) {
+	BlockIndex index;
+	index.num_blocks_ = num_blocks;
+	index.num_levels_ = NumLevels(num_blocks);
+	index.channels_.resize(num_channels);
+	const std::size_t n = num_blocks;
+	for (ChannelIndex& channel: index.channels_) {
+		if (!reader.ReadArray(channel.ones, index.num_levels_ * (n + 1)) || !reader.ReadArray(channel.zeros, index.num_levels_) || !reader.ReadArray(channel.sums, (index.num_levels_ + 1) * (n + 1)) || !reader.ReadArray(channel.peaks, 4 * n)) {
+			return std::nullopt;
+		}
+		// Queries follow the counts, which must then stay within the blocks.
+		for (std::size_t level = 0; level < index.num_levels_; ++level) {
+			const std::uint32_t* const ones = &channel.ones[level * (n + 1)];
+			if (ones[0] != 0 || channel.zeros[level] != n - ones[n]) return std::nullopt;
+			for (std::size_t i = 0; i < n; ++i) {
+				if (ones[i + 1] - ones[i] > 1) return std::nullopt;
+			}
+		}
+	}
+	return index;
+}
+
+}
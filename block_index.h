@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "binary_io.h"
+#include "compute_dr.h"
+
+namespace speedr {
+
+// Answers the rating of any window of whole blocks of a track from its block
+// statistics, in time logarithmic in the number of blocks, after as much work
+// as sorting them once.
+class BlockIndex {
+public:
+	BlockIndex() = default;
+	explicit BlockIndex(const BlockStatistics& statistics);
+
+	std::size_t num_blocks() const { return num_blocks_; }
+
+	// Same as Rating::FromBlockStatistics on blocks [first_block, end_block),
+	// up to the rounding of the sums of mean squares. The window must be a
+	// non-empty part of the track.
+	Rating Rate(std::size_t first_block, std::size_t end_block) const;
+
+	void Serialize(ByteWriter& writer) const;
+	// Returns nothing if what `reader` holds is not the serialized index of
+	// that many channels and blocks.
+	static std::optional<BlockIndex> Deserialize(ByteReader& reader, std::size_t num_channels, std::size_t num_blocks);
+
+private:
+	struct ChannelIndex {
+		// The ranks of the mean squares, one bit per level from the most
+		// significant. Each level lists the blocks in the order left by a
+		// stable partition of the previous one on its bit, and holds how many
+		// of the first i blocks have it set (`ones`), how many do not overall
+		// (`zeros`), and the sum of the first i mean squares (`sums`, which has
+		// one more level for the final order). Summing the largest mean squares
+		// of a window then takes one step per level.
+		std::vector<std::uint32_t> ones;
+		std::vector<std::uint32_t> zeros;
+		std::vector<double> sums;
+		// Segment tree of the two largest peaks under each node, leaves last.
+		std::vector<float> peaks;
+
+		double SumLargestMeanSquares(std::size_t first_block, std::size_t end_block, std::size_t count, std::size_t num_blocks) const;
+		float SecondLargestPeak(std::size_t first_block, std::size_t end_block, std::size_t num_blocks) const;
+	};
+
+	std::size_t num_blocks_ = 0;
+	std::size_t num_levels_ = 0;
+	std::vector<ChannelIndex> channels_;
+};
+
+}
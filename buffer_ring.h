@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <hwy/aligned_allocator.h>
+
+namespace speedr {
+
+// Fixed ring of aligned buffers handed from one producer thread to one
+// consumer thread: the producer fills the buffer returned by `Acquire` and
+// publishes it, the consumer reads the one returned by `Next` and releases it.
+// Neither takes a lock while the other keeps up. Otherwise, it yields a few
+// times, then sleeps until woken, so that it does not take the CPU from the
+// side it waits for on a loaded machine, and adds the time it spent waiting to
+// the `stall_seconds` it is given.
+template <typename T>
+class BufferRing {
+public:
+	BufferRing(const std::size_t num_buffers, const std::size_t buffer_size)
+		: counts_(num_buffers) {
+		buffers_.reserve(num_buffers);
+		for (std::size_t i = 0; i < num_buffers; ++i) {
+			buffers_.push_back(hwy::AllocateAligned<T>(buffer_size));
+		}
+	}
+
+	// Producer side.
+	T* Acquire(double& stall_seconds) {
+		const std::size_t head = head_.load(std::memory_order_relaxed);
+		Wait(stall_seconds, [&] { return head - tail_.load(std::memory_order_acquire) < buffers_.size(); });
+		return buffers_[head % buffers_.size()].get();
+	}
+	// `count` is whatever the consumer needs to know about the buffer, e.g.
+	// how much of it was filled.
+	void Publish(const std::ptrdiff_t count) {
+		const std::size_t head = head_.load(std::memory_order_relaxed);
+		counts_[head % buffers_.size()] = count;
+		head_.store(head + 1, std::memory_order_release);
+		Notify();
+	}
+
+	// Consumer side.
+	const T* Next(std::ptrdiff_t& count, double& stall_seconds) {
+		const std::size_t tail = tail_.load(std::memory_order_relaxed);
+		Wait(stall_seconds, [&] { return head_.load(std::memory_order_acquire) != tail; });
+		count = counts_[tail % buffers_.size()];
+		return buffers_[tail % buffers_.size()].get();
+	}
+	void Release() {
+		tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		Notify();
+	}
+
+private:
+	// Yields before sleeping, as a short wait costs less than a wake-up.
+	static constexpr int kMaxYields = 64;
+
+	template <typename Ready>
+	void Wait(double& stall_seconds, const Ready& ready) {
+		if (ready()) return;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < kMaxYields && !ready(); ++i) {
+			std::this_thread::yield();
+		}
+		if (!ready()) {
+			std::unique_lock<std::mutex> lock(mutex_);
+			waiters_.fetch_add(1, std::memory_order_relaxed);
+			// Pairs with the fence in Notify: either this side sees the other's
+			// progress, or the other sees that this side waits.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			woken_.wait(lock, ready);
+			waiters_.fetch_sub(1, std::memory_order_relaxed);
+		}
+		stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void Notify() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters_.load(std::memory_order_relaxed) > 0) {
+			// Taking the lock ensures the waiter is already asleep, not between its
+			// last check and going to sleep.
+			const std::lock_guard<std::mutex> lock(mutex_);
+			woken_.notify_all();
+		}
+	}
+
+	std::vector<hwy::AlignedFreeUniquePtr<T[]>> buffers_;
+	std::vector<std::ptrdiff_t> counts_;
+	// Numbers of buffers published and released so far. Kept apart so that
+	// the producer and the consumer do not write to the same cache line.
+	alignas(64) std::atomic<std::size_t> head_{0};
+	alignas(64) std::atomic<std::size_t> tail_{0};
+	// Only used once a side stops yielding.
+	std::atomic<int> waiters_{0};
+	std::mutex mutex_;
+	std::condition_variable woken_;
+};
+
+}
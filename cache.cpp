@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "binary_io.h"
+#ifdef SPEEDR_HAVE_MMAP
+#include "mapped_pcm.h"
+#endif
+
+namespace speedr {
+
+namespace {
+
+// Followed by entries made of the size of the key (uint32), the size of the
+// value (uint64), the key and the value.
+constexpr char kMagic[8] = {'S', 'P', 'D', 'R', 'C', 'A', 'C', 'H'};
+constexpr std::uint32_t kFormatVersion = 3;
+constexpr std::size_t kHeaderSize = sizeof kMagic + sizeof kFormatVersion;
+constexpr std::size_t kEntryHeaderSize = sizeof(std::uint32_t) + sizeof(std::uint64_t);
+
+std::string SerializeResult(const CachedResult& result) {
+	ByteWriter writer;
+	writer.Write(result.frames);
+	writer.Write(result.samplerate);
+	const std::vector<float> ratings = result.rating.ChannelRatings();
+	writer.Write(static_cast<std::uint32_t>(ratings.size()));
+	writer.WriteArray(ratings);
+	const std::uint64_t num_blocks = result.statistics.mean_square.empty() ? 0 : result.statistics.mean_square[0].size();
+	writer.Write(num_blocks);
+	// Only samples read as integers have bits.
+	const std::uint8_t has_bits = !result.statistics.bits.empty();
+	writer.Write(has_bits);
+	for (std::size_t c = 0; c < ratings.size(); ++c) {
+		writer.WriteArray(result.statistics.mean_square[c]);
+		writer.WriteArray(result.statistics.peak[c]);
+		writer.WriteArray(result.statistics.clipping[c]);
+		if (has_bits) {
+			writer.WriteArray(result.statistics.bits[c]);
+			writer.WriteArray(result.statistics.sum[c]);
+		}
+	}
+	return writer.bytes();
+}
+
+std::optional<CachedResult> DeserializeResult(const std::string& bytes) {
+	ByteReader reader(bytes);
+	CachedResult result;
+	std::uint32_t num_channels;
+	std::vector<float> ratings;
+	std::uint64_t num_blocks;
+	std::uint8_t has_bits;
+	if (!reader.Read(result.frames) || !reader.Read(result.samplerate) || !reader.Read(num_channels) || num_channels == 0 || !reader.ReadArray(ratings, num_channels) || !reader.Read(num_blocks) || !reader.Read(has_bits)) {
+		return std::nullopt;
+	}
+	result.rating = Rating::FromChannelRatings(std::move(ratings));
+	result.statistics.mean_square.resize(num_channels);
+	result.statistics.peak.resize(num_channels);
+	result.statistics.clipping.resize(num_channels);
+	if (has_bits) {
+		result.statistics.bits.resize(num_channels);
+		result.statistics.sum.resize(num_channels);
+	}
+	for (std::uint32_t c = 0; c < num_channels; ++c) {
+		if (!reader.ReadArray(result.statistics.mean_square[c], num_blocks) || !reader.ReadArray(result.statistics.peak[c], num_blocks) || !reader.ReadArray(result.statistics.clipping[c], num_blocks)) {
+			return std::nullopt;
+		}
+		if (has_bits && (!reader.ReadArray(result.statistics.bits[c], num_blocks) || !reader.ReadArray(result.statistics.sum[c], num_blocks))) {
+			return std::nullopt;
+		}
+	}
+	return result;
+}
+
+// What, besides the audio, can change the results.
+void WriteVersion(ByteWriter& writer) {
+	writer.WriteBytes(SPEEDR_VERSION);
+	writer.WriteBytes("/");
+	writer.WriteBytes(KernelVariant());
+}
+
+// The MD5 of the decoded audio recorded in the STREAMINFO of a native FLAC
+// file, preceded by the fields that hold its sample rate, number of channels,
+// bit depth and length. Returns nothing if `filename` is not a FLAC file or
+// the encoder did not compute the MD5.
+std::optional<std::string> GetFlacKey(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	unsigned char header[10];
+	if (!file.read(reinterpret_cast<char*>(header), 4)) return std::nullopt;
+	if (!std::memcmp(header, "ID3", 3)) {
+		// Skips an ID3v2 tag, which some taggers put in front of the stream.
+		if (!file.read(reinterpret_cast<char*>(&header[4]), 6)) return std::nullopt;
+		const std::uint32_t tag_size = (header[6] & 0x7F) << 21 | (header[7] & 0x7F) << 14 | (header[8] & 0x7F) << 7 | (header[9] & 0x7F);
+		const bool has_footer = header[5] & 0x10;
+		if (!file.seekg(10 + tag_size + (has_footer ? 10 : 0)) || !file.read(reinterpret_cast<char*>(header), 4)) return std::nullopt;
+	}
+	if (std::memcmp(header, "fLaC", 4) != 0) return std::nullopt;
+
+	// The first metadata block is always STREAMINFO.
+	unsigned char block_header[4];
+	unsigned char stream_info[34];
+	if (!file.read(reinterpret_cast<char*>(block_header), 4) || (block_header[0] & 0x7F) != 0 || !file.read(reinterpret_cast<char*>(stream_info), sizeof stream_info)) {
+		return std::nullopt;
+	}
+	const unsigned char* const format = &stream_info[10];
+	const unsigned char* const md5 = &stream_info[18];
+	if (std::all_of(md5, md5 + 16, [](const unsigned char byte) { return byte == 0; })) return std::nullopt;
+
+	ByteWriter writer;
+	writer.WriteBytes("flac:");
+	writer.WriteBytes(std::string(format, md5 + 16));
+	WriteVersion(writer);
+	return writer.bytes();
+}
+
+}
+
+std::optional<std::string> GetContentKey(const std::string& filename) {
+	if (std::optional<std::string> key = GetFlacKey(filename)) {
+		return key;
+	}
+#ifdef SPEEDR_HAVE_MMAP
+	if (const std::optional<MappedPcm> pcm = MappedPcm::Open(filename)) {
+		ByteWriter writer;
+		writer.WriteBytes("pcm:");
+		writer.Write(pcm->HashSamples());
+		writer.Write(pcm->frames());
+		writer.Write(pcm->channels());
+		writer.Write(pcm->samplerate());
+		writer.Write(pcm->layout().encoding);
+		writer.Write(pcm->layout().bytes_per_sample);
+		writer.Write(pcm->layout().big_endian);
+		WriteVersion(writer);
+		return writer.bytes();
+	}
+#endif
+	return std::nullopt;
+}
+
+std::optional<std::string> GetFileKey(const std::string& filename) {
+#ifdef _WIN32
+	static_cast<void>(filename);
+	return std::nullopt;
+#else
+	struct stat status;
+	if (stat(filename.c_str(), &status) != 0) return std::nullopt;
+#ifdef __APPLE__
+	const timespec& mtime = status.st_mtimespec;
+#else
+	const timespec& mtime = status.st_mtim;
+#endif
+	ByteWriter writer;
+	writer.WriteBytes("stat:");
+	writer.Write(static_cast<std::uint64_t>(status.st_dev));
+	writer.Write(static_cast<std::uint64_t>(status.st_ino));
+	writer.Write(static_cast<std::uint64_t>(status.st_size));
+	writer.Write(static_cast<std::int64_t>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec);
+	WriteVersion(writer);
+	return writer.bytes();
+#endif
+}
+
+std::unique_ptr<ResultCache> ResultCache::Open(const std::string& filename) {
+	{
+		// Creates the file without truncating it.
+		std::ofstream create(filename, std::ios::binary | std::ios::app);
+		if (!create) return nullptr;
+	}
+	std::unique_ptr<ResultCache> cache(new ResultCache);
+	std::fstream& file = cache->file_;
+	file.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+	if (!file) return nullptr;
+
+	char header[kHeaderSize];
+	if (!file.read(header, kHeaderSize)) {
+		if (file.gcount() != 0) return nullptr;
+		file.clear();
+		file.seekp(0);
+		file.write(kMagic, sizeof kMagic);
+		file.write(reinterpret_cast<const char*>(&kFormatVersion), sizeof kFormatVersion);
+		file.flush();
+		return file ? std::move(cache) : nullptr;
+	}
+	std::uint32_t version;
+	std::memcpy(&version, &header[sizeof kMagic], sizeof version);
+	if (std::memcmp(header, kMagic, sizeof kMagic) != 0 || version != kFormatVersion) {
+		return nullptr;
+	}
+
+	std::error_code error;
+	const std::uint64_t file_size = std::filesystem::file_size(filename, error);
+	if (error) return nullptr;
+	std::uint64_t offset = kHeaderSize;
+	char entry_header[kEntryHeaderSize];
+	while (file.read(entry_header, kEntryHeaderSize)) {
+		std::uint32_t key_size;
+		std::uint64_t value_size;
+		std::memcpy(&key_size, entry_header, sizeof key_size);
+		std::memcpy(&value_size, &entry_header[sizeof key_size], sizeof value_size);
+		const std::uint64_t value_offset = offset + kEntryHeaderSize + key_size;
+		if (value_offset > file_size || value_size > file_size - value_offset) break;
+		std::string key(key_size, '\0');
+		if (!file.read(key.data(), key_size) || !file.seekg(value_size, std::ios::cur)) break;
+		cache->values_[std::move(key)] = {value_offset, value_size};
+		offset = value_offset + value_size;
+	}
+	file.clear();
+
+	// Drops an entry left incomplete by an interrupted run, so that the next
+	// ones can be found.
+	if (file_size > offset) {
+		file.close();
+		std::filesystem::resize_file(filename, offset, error);
+		file.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+		if (error || !file) return nullptr;
+	}
+	return cache;
+}
+
+std::optional<CachedResult> ResultCache::Find(const std::string& key) {
+	const std::lock_guard lock(mutex_);
+	const auto entry = values_.find(key);
+	if (entry == values_.end()) return std::nullopt;
+	const auto [offset, size] = entry->second;
+	std::string value(size, '\0');
+	file_.seekg(offset);
+	if (!file_.read(value.data(), size)) {
+		file_.clear();
+		return std::nullopt;
+	}
+	return DeserializeResult(value);
+}
+
+void ResultCache::Store(const std::string& key, const CachedResult& result) {
+	const std::string value = SerializeResult(result);
+	const auto key_size = static_cast<std::uint32_t>(key.size());
+	const std::uint64_t value_size = value.size();
+
+	const std::lock_guard lock(mutex_);
+	file_.seekp(0, std::ios::end);
+	const std::uint64_t value_offset = static_cast<std::uint64_t>(file_.tellp()) + kEntryHeaderSize + key_size;
+	file_.write(reinterpret_cast<const char*>(&key_size), sizeof key_size);
+	file_.write(reinterpret_cast<const char*>(&value_size), sizeof value_size);
+	file_.write(key.data(), key_size);
+	file_.write(value.data(), value_size);
+	file_.flush();
+	if (file_) {
+		values_[key] = {value_offset, value_size};
+	}
+	file_.clear();
+}
+
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "compute_dr.h"
+
+namespace speedr {
+
+// What is kept of an analysed track.
+struct CachedResult {
+	Rating rating;
+	BlockStatistics statistics;
+	std::uint64_t frames;
+	int samplerate;
+};
+
+// Identifies the current contents of `filename` by its device, inode, size
+// and modification time, along with the version of speedr and the kernel
+// variant, which could both change the results. Returns nothing if the file
+// cannot be examined, or on systems where these are not available.
+std::optional<std::string> GetFileKey(const std::string& filename);
+
+// Identifies the audio in `filename` regardless of its tags, name or location:
+// by the MD5 that FLAC files carry in their STREAMINFO, which is found in the
+// first few bytes, or by a hash of the samples of uncompressed files, which
+// have to be read in full. Returns nothing for other files, and for FLAC
+// files whose encoder did not record the MD5.
+std::optional<std::string> GetContentKey(const std::string& filename);
+
+// Results of previous runs, in a single file to which new results are
+// appended. Only the keys are read when it is opened; a result is read back
+// when it is looked up. Of several results with the same key, the last one
+// wins. Can be shared by threads.
+class ResultCache {
+public:
+	// Creates the file if needed. Returns nothing if it cannot be created, or
+	// is not a cache of this version.
+	static std::unique_ptr<ResultCache> Open(const std::string& filename);
+
+	std::optional<CachedResult> Find(const std::string& key);
+	void Store(const std::string& key, const CachedResult& result);
+
+private:
+	ResultCache() = default;
+
+	std::mutex mutex_;
+	std::fstream file_;
+	// Offset and size of the latest value stored for each key.
+	std::unordered_map<std::string, std::pair<std::uint64_t, std::uint64_t>> values_;
+};
+
+}
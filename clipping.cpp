@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "clipping.h"
+
+#include <algorithm>
+
+namespace speedr {
+
+std::optional<Clipping> FindClipping(const BlockStatistics& statistics) {
+	if (statistics.clipping.empty()) return std::nullopt;
+	Clipping clipping = {};
+	for (const std::vector<ClippedSamples>& channel: statistics.clipping) {
+		// Of the run that goes on from the previous blocks.
+		std::uint64_t run = 0;
+		// Adds `length` samples to the run, which counts once it reaches the
+		// minimum.
+		const auto extend_run = [&](const std::uint32_t length, const std::uint64_t block) {
+			if (run < kMinClippingRun && run + length >= kMinClippingRun) {
+				++clipping.runs;
+				clipping.blocks.push_back(block);
+			}
+			run += length;
+		};
+		for (std::uint64_t block = 0; block < channel.size(); ++block) {
+			const ClippedSamples& samples = channel[block];
+			clipping.clipped_samples += samples.count;
+			// The head and the tail can only both hold all the clipped samples
+			// if they are the whole block.
+			if (samples.count > 0 && samples.head == samples.count && samples.tail == samples.count) {
+				extend_run(samples.count, block);
+				continue;
+			}
+			extend_run(samples.head, block);
+			if (samples.runs > 0) {
+				clipping.runs += samples.runs;
+				clipping.blocks.push_back(block);
+			}
+			run = 0;
+			extend_run(samples.tail, block);
+		}
+	}
+	std::sort(clipping.blocks.begin(), clipping.blocks.end());
+	clipping.blocks.erase(std::unique(clipping.blocks.begin(), clipping.blocks.end()), clipping.blocks.end());
+	return clipping;
+}
+
+}
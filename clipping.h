@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "compute_dr.h"
+
+namespace speedr {
+
+struct Clipping {
+	// Over all channels, of at least kClippingLevel.
+	std::uint64_t clipped_samples;
+	// Runs of at least kMinClippingRun consecutive clipped samples of a
+	// channel.
+	std::uint64_t runs;
+	// Blocks (of GetBlockSize frames, as for DR) in which runs reach that
+	// minimum, in increasing order and without repetition.
+	std::vector<std::uint64_t> blocks;
+};
+
+// From the clipped samples of the blocks of a track, following the runs that
+// go on from one block to the next, or nothing if they were not counted.
+std::optional<Clipping> FindClipping(const BlockStatistics& statistics);
+
+}
@@ -14,11 +14,27 @@
 // limitations under the License.
 
 #include "compute_dr.h"
+#include "buffer_ring.h"
+#include "meters.h"
+
+#ifdef SPEEDR_HAVE_FLAC
+#include "flac_dr.h"
+#endif
+#ifdef SPEEDR_HAVE_MMAP
+#include "mapped_pcm.h"
+#endif
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <functional>
+#include <limits>
 #include <numeric>
+#include <optional>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #undef HWY_TARGET_INCLUDE
@@ -35,37 +51,543 @@ namespace {
 
 namespace hn = hwy::HWY_NAMESPACE;
 
-int GetBlockSize(const SndfileHandle& input) {
-	const int samplerate = input.samplerate();
-	return std::lround(3.f * static_cast<float>(samplerate) * 44160.f / 44100);
+std::size_t NumLanes() {
+	return hn::Lanes(HWY_FULL(float)());
+}
+
+std::int64_t Target() {
+	return HWY_TARGET;
+}
+
+// Formats provide `Load` and `LoadN` to turn samples stored as `Sample` into
+// lanes of float (for AccumulateSamples) or of int32 (for
+// AccumulateIntegerSamples). `LoadN` zeroes the lanes beyond `n`.
+
+struct FloatSamples {
+	using Sample = float;
+
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Load(D d, const Sample* HWY_RESTRICT samples) const {
+		return hn::LoadU(d, samples);
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> LoadN(D d, const Sample* HWY_RESTRICT samples, const std::size_t n) const {
+		return hn::LoadN(d, samples, n);
+	}
+};
+
+template <class V>
+HWY_ATTR V ByteSwap32(const V v) {
+	const hn::DFromV<V> d;
+	const V middle_bytes = hn::Set(d, 0x00FF00FF);
+	const V swapped_halves = hn::Or(hn::ShiftLeft<16>(v), hn::ShiftRight<16>(v));
+	return hn::Or(hn::ShiftLeft<8>(hn::And(swapped_halves, middle_bytes)), hn::And(hn::ShiftRight<8>(swapped_halves), middle_bytes));
 }
 
-HWY_ATTR Rating::MonoRating ComputeMonoDR(SndfileHandle& input) {
+// Floats of the opposite endianness.
+struct SwappedFloatSamples {
+	using Sample = std::uint32_t;
+
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Load(D d, const Sample* HWY_RESTRICT samples) const {
+		return hn::BitCast(d, ByteSwap32(hn::LoadU(hn::RebindToUnsigned<D>(), samples)));
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> LoadN(D d, const Sample* HWY_RESTRICT samples, const std::size_t n) const {
+		return hn::BitCast(d, ByteSwap32(hn::LoadN(hn::RebindToUnsigned<D>(), samples, n)));
+	}
+};
+
+// 32-bit integers, whose squares would not fit 64-bit lanes, scaled to floats.
+template <bool kSwapped>
+struct Int32AsFloatSamples {
+	using Sample = std::uint32_t;
+
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Convert(D d, hn::VFromD<hn::RebindToUnsigned<D>> v) const {
+		if constexpr (kSwapped) {
+			v = ByteSwap32(v);
+		}
+		return hn::Mul(hn::ConvertTo(d, hn::BitCast(hn::RebindToSigned<D>(), v)), hn::Set(d, 0x1p-31f));
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Load(D d, const Sample* HWY_RESTRICT samples) const {
+		return Convert(d, hn::LoadU(hn::RebindToUnsigned<D>(), samples));
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> LoadN(D d, const Sample* HWY_RESTRICT samples, const std::size_t n) const {
+		return Convert(d, hn::LoadN(hn::RebindToUnsigned<D>(), samples, n));
+	}
+};
+
+// Follows the runs of clipped samples of each channel through a batch of
+// `count` interleaved samples, which must be whole frames, after the kernel
+// has counted `num_clipped` of them. Since clipping is rare, the batch is only
+// looked at again if it has any, and then only the lanes of vectors that hold
+// any are looked at one by one.
+template <class D, class Format>
+HWY_ATTR void FollowClippingRuns(D d, const Format& format, const typename Format::Sample* HWY_RESTRICT samples, const std::size_t count, const std::uint32_t num_clipped, const hn::VFromD<D> level, const int num_channels, ClippingTracker* HWY_RESTRICT clipping) {
+	if (num_clipped == 0) {
+		for (int c = 0; c < num_channels; ++c) {
+			clipping[c].Add(false);
+		}
+		return;
+	}
+	const hn::RebindToSigned<D> di;
+	const std::size_t num_lanes = hn::Lanes(d);
+	HWY_ALIGN std::int32_t clipped_lanes[HWY_MAX_BYTES / sizeof(std::int32_t)];
+	for (std::size_t i = 0; i < count; i += num_lanes) {
+		const std::size_t n = std::min(num_lanes, count - i);
+		const auto clipped = hn::Ge(hn::Abs(n == num_lanes ? format.Load(d, &samples[i]) : format.LoadN(d, &samples[i], n)), level);
+		if (hn::AllFalse(d, clipped)) {
+			// Ends the runs of the channels in the vector.
+			for (std::size_t lane = 0; lane < std::min<std::size_t>(n, num_channels); ++lane) {
+				clipping[(i + lane) % num_channels].Add(false);
+			}
+			continue;
+		}
+		hn::Store(hn::BitCast(di, hn::VecFromMask(d, clipped)), di, clipped_lanes);
+		for (std::size_t lane = 0; lane < n; ++lane) {
+			clipping[(i + lane) % num_channels].Add(clipped_lanes[lane] != 0);
+		}
+	}
+}
+
+// Adds `count` interleaved samples to per-position sums of squares and peaks,
+// where `num_positions` is a common multiple of the number of lanes and the
+// number of channels: position `p` then always holds samples of channel
+// `p % num_channels`, without any deinterleaving. Unless this ends a block,
+// `count` must be a multiple of `num_positions`, so that every vector covers
+// the same samples regardless of how the block was split into calls. The
+// clipped samples of each channel are counted into `clipping`.
+template <class Format>
+HWY_ATTR void AccumulateSamples(const Format& format, const typename Format::Sample* HWY_RESTRICT samples, const std::size_t count, const int num_channels, const std::size_t num_positions, float* HWY_RESTRICT sums_of_squares, float* HWY_RESTRICT peaks, ClippingTracker* HWY_RESTRICT clipping) {
 	HWY_FULL(float) d;
+	const hn::RebindToSigned<decltype(d)> di;
 	using V = decltype(hn::Zero(d));
-	const int block_size = GetBlockSize(input);
-	const auto num_blocks = std::max<std::size_t>(1, (input.frames() + block_size - 1) / block_size);
-	const auto num_top_blocks = std::max<std::size_t>(1, num_blocks / 5);
-	hwy::AlignedFreeUniquePtr<float[]> block_samples = hwy::AllocateAligned<float>(block_size);
-	std::vector<float> block_mean_square;
-	std::vector<float> block_peak;
-	block_mean_square.reserve(num_blocks);
-	block_peak.reserve(num_blocks);
-
-	for (std::size_t i_block = 0; i_block < num_blocks; ++i_block) {
-		const std::size_t samples_read = input.readf(block_samples.get(), block_size);
-
-		V sums_of_squares = hn::Zero(d);
-		V peaks = hn::Zero(d);
-		hn::Foreach(d, block_samples.get(), samples_read, hn::Zero(d), [&](auto d, const V samples) HWY_ATTR {
-			sums_of_squares = hn::MulAdd(samples, samples, sums_of_squares);
-			peaks = hn::Max(peaks, hn::Abs(samples));
-		});
-		const float sum_of_squares = hn::ReduceSum(d, sums_of_squares);
-		block_mean_square.push_back(sum_of_squares / samples_read);
-		block_peak.push_back(hn::ReduceMax(d, peaks));
+	using VI = decltype(hn::Zero(di));
+	const std::size_t num_lanes = hn::Lanes(d);
+	const V level = hn::Set(d, kClippingLevel);
+	// Each position is accumulated over a whole batch before moving on to the
+	// next one, so the batch should stay in L1.
+	static constexpr std::size_t kBatchSize = 4096;
+	const std::size_t batch_size = std::max(num_positions, kBatchSize - kBatchSize % num_positions);
+	HWY_ALIGN std::int32_t clipped_lanes[HWY_MAX_BYTES / sizeof(std::int32_t)];
+	for (std::size_t batch_start = 0; batch_start < count; batch_start += batch_size) {
+		const typename Format::Sample* const HWY_RESTRICT batch = &samples[batch_start];
+		const std::size_t batch_count = std::min(count - batch_start, batch_size);
+		std::uint32_t batch_clipped = 0;
+		for (std::size_t position = 0; position < num_positions; position += num_lanes) {
+			V position_sums_of_squares = hn::Load(d, &sums_of_squares[position]);
+			V position_peaks = hn::Load(d, &peaks[position]);
+			VI position_clipped = hn::Zero(di);
+			const auto accumulate = [&](const V v) HWY_ATTR {
+				const V magnitude = hn::Abs(v);
+				position_sums_of_squares = hn::MulAdd(v, v, position_sums_of_squares);
+				position_peaks = hn::Max(position_peaks, magnitude);
+				// Clipped lanes are all ones, i.e. -1.
+				position_clipped = hn::Sub(position_clipped, hn::BitCast(di, hn::VecFromMask(d, hn::Ge(magnitude, level))));
+			};
+			std::size_t i;
+			for (i = position; i + num_lanes <= batch_count; i += num_positions) {
+				accumulate(format.Load(d, &batch[i]));
+			}
+			if (i < batch_count) {
+				accumulate(format.LoadN(d, &batch[i], batch_count - i));
+			}
+			hn::Store(position_sums_of_squares, d, &sums_of_squares[position]);
+			hn::Store(position_peaks, d, &peaks[position]);
+			hn::Store(position_clipped, di, clipped_lanes);
+			for (std::size_t lane = 0; lane < num_lanes; ++lane) {
+				clipping[(position + lane) % num_channels].block.count += clipped_lanes[lane];
+				batch_clipped += clipped_lanes[lane];
+			}
+		}
+		FollowClippingRuns(d, format, batch, batch_count, batch_clipped, level, num_channels, clipping);
 	}
+}
+
+HWY_ATTR void AccumulateFloatSamples(const float* HWY_RESTRICT samples, const std::size_t count, const int num_channels, const std::size_t num_positions, float* HWY_RESTRICT sums_of_squares, float* HWY_RESTRICT peaks, ClippingTracker* HWY_RESTRICT clipping) {
+	AccumulateSamples(FloatSamples{}, samples, count, num_channels, num_positions, sums_of_squares, peaks, clipping);
+}
+
+// For 32-bit float or integer samples in `layout`.
+HWY_ATTR void AccumulateRawSamples(const std::uint8_t* HWY_RESTRICT bytes, const std::size_t count, const PcmLayout& layout, const int num_channels, const std::size_t num_positions, float* HWY_RESTRICT sums_of_squares, float* HWY_RESTRICT peaks, ClippingTracker* HWY_RESTRICT clipping) {
+	const auto* const HWY_RESTRICT samples = reinterpret_cast<const std::uint32_t*>(bytes);
+	const bool swapped = layout.big_endian != kBigEndianHost;
+	const auto accumulate = [&](const auto& format, const auto* const typed_samples) HWY_ATTR {
+		AccumulateSamples(format, typed_samples, count, num_channels, num_positions, sums_of_squares, peaks, clipping);
+	};
+	if (layout.encoding == PcmLayout::Encoding::kFloat) {
+		if (swapped) {
+			accumulate(SwappedFloatSamples{}, samples);
+		}
+		else {
+			accumulate(FloatSamples{}, reinterpret_cast<const float*>(bytes));
+		}
+	}
+	else if (swapped) {
+		accumulate(Int32AsFloatSamples<true>{}, samples);
+	}
+	else {
+		accumulate(Int32AsFloatSamples<false>{}, samples);
+	}
+}
+
+template <typename Byte>
+struct Int8Samples {
+	using Sample = Byte;
+
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Convert(D d, const hn::VFromD<hn::Rebind<Sample, D>> v) const {
+		if constexpr (std::is_signed_v<Byte>) {
+			return hn::PromoteTo(d, v);
+		}
+		else {
+			return hn::Sub(hn::PromoteTo(d, v), hn::Set(d, 128));
+		}
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Load(D d, const Sample* HWY_RESTRICT samples) const {
+		return Convert(d, hn::LoadU(hn::Rebind<Sample, D>(), samples));
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> LoadN(D d, const Sample* HWY_RESTRICT samples, const std::size_t n) const {
+		// Padding must be silent once converted.
+		const hn::Rebind<Sample, D> d8;
+		return hn::IfThenElseZero(hn::FirstN(d, n), Convert(d, hn::LoadN(d8, samples, n)));
+	}
+};
+
+struct Int16Samples {
+	using Sample = std::int16_t;
 
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Load(D d, const Sample* HWY_RESTRICT samples) const {
+		return hn::PromoteTo(d, hn::LoadU(hn::Rebind<Sample, D>(), samples));
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> LoadN(D d, const Sample* HWY_RESTRICT samples, const std::size_t n) const {
+		return hn::PromoteTo(d, hn::LoadN(hn::Rebind<Sample, D>(), samples, n));
+	}
+};
+
+struct Int32Samples {
+	using Sample = std::int32_t;
+	// Number of insignificant low bits.
+	int shift;
+
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Load(D d, const Sample* HWY_RESTRICT samples) const {
+		return hn::ShiftRightSame(hn::LoadU(d, samples), shift);
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> LoadN(D d, const Sample* HWY_RESTRICT samples, const std::size_t n) const {
+		return hn::ShiftRightSame(hn::LoadN(d, samples, n), shift);
+	}
+};
+
+// 16-bit integers of the opposite endianness.
+struct SwappedInt16Samples {
+	using Sample = std::uint16_t;
+
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Convert(D d, const hn::VFromD<hn::Rebind<Sample, D>> v) const {
+		const hn::Rebind<std::int16_t, D> d16;
+		return hn::PromoteTo(d, hn::BitCast(d16, hn::Or(hn::ShiftLeft<8>(v), hn::ShiftRight<8>(v))));
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Load(D d, const Sample* HWY_RESTRICT samples) const {
+		return Convert(d, hn::LoadU(hn::Rebind<Sample, D>(), samples));
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> LoadN(D d, const Sample* HWY_RESTRICT samples, const std::size_t n) const {
+		return Convert(d, hn::LoadN(hn::Rebind<Sample, D>(), samples, n));
+	}
+};
+
+struct Packed24 {
+	std::uint8_t bytes[3];
+};
+
+// Packed 3-byte integers, deinterleaved into their low, middle and high bytes
+// and reassembled in 32-bit lanes.
+template <bool kBigEndian>
+struct Packed24Samples {
+	using Sample = Packed24;
+
+	template <class D>
+	HWY_ATTR hn::VFromD<D> Load(D d, const Sample* HWY_RESTRICT samples) const {
+		const hn::Rebind<std::uint8_t, D> d8;
+		const hn::RebindToUnsigned<D> du;
+		hn::VFromD<decltype(d8)> first, middle, last;
+		hn::LoadInterleaved3(d8, samples->bytes, first, middle, last);
+		const auto high = hn::PromoteTo(du, kBigEndian ? first : last);
+		const auto low = hn::PromoteTo(du, kBigEndian ? last : first);
+		const auto shifted = hn::Or(hn::Or(hn::ShiftLeft<24>(high), hn::ShiftLeft<16>(hn::PromoteTo(du, middle))), hn::ShiftLeft<8>(low));
+		// Sign-extends.
+		return hn::ShiftRight<8>(hn::BitCast(d, shifted));
+	}
+	template <class D>
+	HWY_ATTR hn::VFromD<D> LoadN(D d, const Sample* HWY_RESTRICT samples, const std::size_t n) const {
+		Packed24 padded[HWY_MAX_BYTES / sizeof(std::int32_t)] = {};
+		std::copy_n(samples, n, padded);
+		return Load(d, padded);
+	}
+};
+
+// Integer counterpart of AccumulateSamples, with the same layout of positions,
+// except that the per-position results are folded into the sums and peaks of
+// each channel after every batch: squares of samples of at most 24 bits are
+// exact in 64-bit lanes for a batch, but not necessarily for a whole block.
+// Since the sums are exact, `count` need not be a multiple of `num_positions`.
+// The samples of each channel are also ORed into `bits` and summed into
+// `sums`, which tell its word length and DC offset, and those at least
+// `clipping_level` from zero are counted into `clipping`.
+template <class Format>
+HWY_ATTR void AccumulateIntegerSamples(const Format& format, const typename Format::Sample* HWY_RESTRICT samples, const std::size_t count, const int num_channels, const std::size_t num_positions, const std::int32_t clipping_level, ExactSum* HWY_RESTRICT sums_of_squares, std::int32_t* HWY_RESTRICT peaks, std::uint32_t* HWY_RESTRICT bits, std::int64_t* HWY_RESTRICT sums, ClippingTracker* HWY_RESTRICT clipping) {
+	HWY_FULL(std::int32_t) d;
+	const hn::Repartition<std::int64_t, decltype(d)> d64;
+	using V = decltype(hn::Zero(d));
+	using V64 = decltype(hn::Zero(d64));
+	const std::size_t num_lanes = hn::Lanes(d);
+	HWY_ALIGN std::int64_t even_lanes[HWY_MAX_BYTES / sizeof(std::int64_t)];
+	HWY_ALIGN std::int64_t odd_lanes[HWY_MAX_BYTES / sizeof(std::int64_t)];
+	HWY_ALIGN std::int32_t peak_lanes[HWY_MAX_BYTES / sizeof(std::int32_t)];
+	HWY_ALIGN std::int32_t bit_lanes[HWY_MAX_BYTES / sizeof(std::int32_t)];
+	HWY_ALIGN std::int32_t clipped_lanes[HWY_MAX_BYTES / sizeof(std::int32_t)];
+	const V level = hn::Set(d, clipping_level);
+	static constexpr std::size_t kBatchSize = 4096;
+	const std::size_t batch_size = std::max(num_positions, kBatchSize - kBatchSize % num_positions);
+	for (std::size_t batch_start = 0; batch_start < count; batch_start += batch_size) {
+		const typename Format::Sample* const HWY_RESTRICT batch = &samples[batch_start];
+		const std::size_t batch_count = std::min(count - batch_start, batch_size);
+		std::uint32_t batch_clipped = 0;
+		for (std::size_t position = 0; position < num_positions; position += num_lanes) {
+			V64 even_sums_of_squares = hn::Zero(d64);
+			V64 odd_sums_of_squares = hn::Zero(d64);
+			V64 even_sums = hn::Zero(d64);
+			V64 odd_sums = hn::Zero(d64);
+			V position_peaks = hn::Zero(d);
+			V position_bits = hn::Zero(d);
+			V position_clipped = hn::Zero(d);
+			const auto accumulate = [&](const V v) HWY_ATTR {
+				const V64 wide = hn::BitCast(d64, v);
+				const V odd = hn::BitCast(d, hn::ShiftRight<32>(wide));
+				even_sums_of_squares = hn::Add(even_sums_of_squares, hn::MulEven(v, v));
+				odd_sums_of_squares = hn::Add(odd_sums_of_squares, hn::MulEven(odd, odd));
+				// Sign-extends each half of the 64-bit lanes.
+				even_sums = hn::Add(even_sums, hn::ShiftRight<32>(hn::ShiftLeft<32>(wide)));
+				odd_sums = hn::Add(odd_sums, hn::ShiftRight<32>(wide));
+				const V magnitude = hn::Abs(v);
+				position_peaks = hn::Max(position_peaks, magnitude);
+				position_bits = hn::Or(position_bits, v);
+				// Clipped lanes are all ones, i.e. -1.
+				position_clipped = hn::Sub(position_clipped, hn::VecFromMask(d, hn::Ge(magnitude, level)));
+			};
+			std::size_t i;
+			for (i = position; i + num_lanes <= batch_count; i += num_positions) {
+				accumulate(format.Load(d, &batch[i]));
+			}
+			if (i < batch_count) {
+				accumulate(format.LoadN(d, &batch[i], batch_count - i));
+			}
+			hn::Store(even_sums_of_squares, d64, even_lanes);
+			hn::Store(odd_sums_of_squares, d64, odd_lanes);
+			for (std::size_t lane = 0; lane < num_lanes; lane += 2) {
+				sums_of_squares[(position + lane) % num_channels].Add(even_lanes[lane / 2]);
+				sums_of_squares[(position + lane + 1) % num_channels].Add(odd_lanes[lane / 2]);
+			}
+			hn::Store(even_sums, d64, even_lanes);
+			hn::Store(odd_sums, d64, odd_lanes);
+			for (std::size_t lane = 0; lane < num_lanes; lane += 2) {
+				sums[(position + lane) % num_channels] += even_lanes[lane / 2];
+				sums[(position + lane + 1) % num_channels] += odd_lanes[lane / 2];
+			}
+			hn::Store(position_peaks, d, peak_lanes);
+			hn::Store(position_bits, d, bit_lanes);
+			hn::Store(position_clipped, d, clipped_lanes);
+			for (std::size_t lane = 0; lane < num_lanes; ++lane) {
+				const std::size_t c = (position + lane) % num_channels;
+				peaks[c] = std::max(peaks[c], peak_lanes[lane]);
+				bits[c] |= static_cast<std::uint32_t>(bit_lanes[lane]);
+				clipping[c].block.count += clipped_lanes[lane];
+				batch_clipped += clipped_lanes[lane];
+			}
+		}
+		FollowClippingRuns(d, format, batch, batch_count, batch_clipped, level, num_channels, clipping);
+	}
+}
+
+HWY_ATTR void AccumulateInt16Samples(const std::int16_t* HWY_RESTRICT samples, const std::size_t count, const int num_channels, const std::size_t num_positions, const std::int32_t clipping_level, ExactSum* HWY_RESTRICT sums_of_squares, std::int32_t* HWY_RESTRICT peaks, std::uint32_t* HWY_RESTRICT bits, std::int64_t* HWY_RESTRICT sums, ClippingTracker* HWY_RESTRICT clipping) {
+	AccumulateIntegerSamples(Int16Samples{}, samples, count, num_channels, num_positions, clipping_level, sums_of_squares, peaks, bits, sums, clipping);
+}
+
+HWY_ATTR void AccumulateInt32Samples(const std::int32_t* HWY_RESTRICT samples, const std::size_t count, const int shift, const int num_channels, const std::size_t num_positions, const std::int32_t clipping_level, ExactSum* HWY_RESTRICT sums_of_squares, std::int32_t* HWY_RESTRICT peaks, std::uint32_t* HWY_RESTRICT bits, std::int64_t* HWY_RESTRICT sums, ClippingTracker* HWY_RESTRICT clipping) {
+	AccumulateIntegerSamples(Int32Samples{shift}, samples, count, num_channels, num_positions, clipping_level, sums_of_squares, peaks, bits, sums, clipping);
+}
+
+// For integer samples of at most 3 bytes in `layout`.
+HWY_ATTR void AccumulateRawIntegerSamples(const std::uint8_t* HWY_RESTRICT bytes, const std::size_t count, const PcmLayout& layout, const int num_channels, const std::size_t num_positions, const std::int32_t clipping_level, ExactSum* HWY_RESTRICT sums_of_squares, std::int32_t* HWY_RESTRICT peaks, std::uint32_t* HWY_RESTRICT bits, std::int64_t* HWY_RESTRICT sums, ClippingTracker* HWY_RESTRICT clipping) {
+	const bool swapped = layout.big_endian != kBigEndianHost;
+	const auto accumulate = [&](const auto& format, const auto* const typed_samples) HWY_ATTR {
+		AccumulateIntegerSamples(format, typed_samples, count, num_channels, num_positions, clipping_level, sums_of_squares, peaks, bits, sums, clipping);
+	};
+	switch (layout.bytes_per_sample) {
+		case 1:
+			if (layout.encoding == PcmLayout::Encoding::kUnsignedInteger) {
+				accumulate(Int8Samples<std::uint8_t>{}, bytes);
+			}
+			else {
+				accumulate(Int8Samples<std::int8_t>{}, reinterpret_cast<const std::int8_t*>(bytes));
+			}
+			break;
+		case 2:
+			if (swapped) {
+				accumulate(SwappedInt16Samples{}, reinterpret_cast<const std::uint16_t*>(bytes));
+			}
+			else {
+				accumulate(Int16Samples{}, reinterpret_cast<const std::int16_t*>(bytes));
+			}
+			break;
+		case 3:
+			if (layout.big_endian) {
+				accumulate(Packed24Samples<true>{}, reinterpret_cast<const Packed24*>(bytes));
+			}
+			else {
+				accumulate(Packed24Samples<false>{}, reinterpret_cast<const Packed24*>(bytes));
+			}
+			break;
+	}
+}
+
+// Stores `count` samples as floats, with the loads of `format`, whose lanes
+// are integers to multiply by `scale` if `kIntegerLanes`, else floats.
+template <bool kIntegerLanes, class Format>
+HWY_ATTR void ConvertFormatSamples(const Format& format, const typename Format::Sample* HWY_RESTRICT samples, const std::size_t count, const float scale, float* HWY_RESTRICT converted) {
+	HWY_FULL(float) d;
+	const hn::RebindToSigned<decltype(d)> di;
+	const std::size_t num_lanes = hn::Lanes(d);
+	const auto load = [&](const std::size_t i, const std::size_t n) HWY_ATTR {
+		if constexpr (kIntegerLanes) {
+			const auto v = n == num_lanes ? format.Load(di, &samples[i]) : format.LoadN(di, &samples[i], n);
+			return hn::Mul(hn::ConvertTo(d, v), hn::Set(d, scale));
+		}
+		else {
+			return n == num_lanes ? format.Load(d, &samples[i]) : format.LoadN(d, &samples[i], n);
+		}
+	};
+	std::size_t i = 0;
+	for (; i + num_lanes <= count; i += num_lanes) {
+		hn::StoreU(load(i, num_lanes), d, &converted[i]);
+	}
+	if (i < count) {
+		hn::StoreN(load(i, count - i), d, &converted[i], count - i);
+	}
+}
+
+HWY_ATTR void ConvertInt16Samples(const std::int16_t* HWY_RESTRICT samples, const std::size_t count, float* HWY_RESTRICT converted) {
+	ConvertFormatSamples<true>(Int16Samples{}, samples, count, 0x1p-15f, converted);
+}
+
+HWY_ATTR void ConvertInt32Samples(const std::int32_t* HWY_RESTRICT samples, const std::size_t count, const int bits_per_sample, float* HWY_RESTRICT converted) {
+	ConvertFormatSamples<true>(Int32Samples{0}, samples, count, std::ldexp(1.f, 1 - bits_per_sample), converted);
+}
+
+HWY_ATTR void ConvertRawSamples(const std::uint8_t* HWY_RESTRICT bytes, const std::size_t count, const PcmLayout& layout, float* HWY_RESTRICT converted) {
+	const bool swapped = layout.big_endian != kBigEndianHost;
+	const float scale = std::ldexp(1.f, 1 - 8 * layout.bytes_per_sample);
+	const auto convert_integers = [&](const auto& format, const auto* const typed_samples) HWY_ATTR {
+		ConvertFormatSamples<true>(format, typed_samples, count, scale, converted);
+	};
+	const auto convert_floats = [&](const auto& format, const auto* const typed_samples) HWY_ATTR {
+		ConvertFormatSamples<false>(format, typed_samples, count, 1.f, converted);
+	};
+	switch (layout.bytes_per_sample) {
+		case 1:
+			if (layout.encoding == PcmLayout::Encoding::kUnsignedInteger) {
+				convert_integers(Int8Samples<std::uint8_t>{}, bytes);
+			}
+			else {
+				convert_integers(Int8Samples<std::int8_t>{}, reinterpret_cast<const std::int8_t*>(bytes));
+			}
+			break;
+		case 2:
+			if (swapped) {
+				convert_integers(SwappedInt16Samples{}, reinterpret_cast<const std::uint16_t*>(bytes));
+			}
+			else {
+				convert_integers(Int16Samples{}, reinterpret_cast<const std::int16_t*>(bytes));
+			}
+			break;
+		case 3:
+			if (layout.big_endian) {
+				convert_integers(Packed24Samples<true>{}, reinterpret_cast<const Packed24*>(bytes));
+			}
+			else {
+				convert_integers(Packed24Samples<false>{}, reinterpret_cast<const Packed24*>(bytes));
+			}
+			break;
+		case 4: {
+			const auto* const samples = reinterpret_cast<const std::uint32_t*>(bytes);
+			if (layout.encoding == PcmLayout::Encoding::kFloat) {
+				if (swapped) {
+					convert_floats(SwappedFloatSamples{}, samples);
+				}
+				else {
+					convert_floats(FloatSamples{}, reinterpret_cast<const float*>(bytes));
+				}
+			}
+			else if (swapped) {
+				convert_floats(Int32AsFloatSamples<true>{}, samples);
+			}
+			else {
+				convert_floats(Int32AsFloatSamples<false>{}, samples);
+			}
+			break;
+		}
+	}
+}
+
+}
+}
+
+#if HWY_ONCE
+
+namespace {
+HWY_EXPORT(NumLanes);
+HWY_EXPORT(Target);
+HWY_EXPORT(AccumulateFloatSamples);
+HWY_EXPORT(AccumulateRawSamples);
+HWY_EXPORT(AccumulateInt16Samples);
+HWY_EXPORT(AccumulateInt32Samples);
+HWY_EXPORT(AccumulateRawIntegerSamples);
+HWY_EXPORT(ConvertInt16Samples);
+HWY_EXPORT(ConvertInt32Samples);
+HWY_EXPORT(ConvertRawSamples);
+
+// Below this, splitting an input costs more in extra handles than it saves.
+constexpr std::size_t kMinBlocksPerRange = 4;
+// Number of samples read from an input at a time.
+constexpr std::size_t kReadSize = 1 << 16;
+// Number of buffers that a pipelined decoder can get ahead of the analysis.
+constexpr std::size_t kPipelineDepth = 4;
+
+std::size_t GetNumBlocks(const std::uint64_t frames, const int samplerate) {
+	const int block_size = GetBlockSize(samplerate);
+	return std::max<std::size_t>(1, (frames + block_size - 1) / block_size);
+}
+
+std::size_t GetNumBlocks(const SndfileHandle& input) {
+	return GetNumBlocks(input.frames(), input.samplerate());
+}
+
+std::size_t GetNumRanges(const std::size_t num_blocks, const int num_threads) {
+	return std::max<std::size_t>(1, std::min<std::size_t>(num_threads, num_blocks / kMinBlocksPerRange));
+}
+
+float ComputeChannelRating(std::vector<float>& block_mean_square, std::vector<float>& block_peak) {
+	const auto num_top_blocks = std::max<std::size_t>(1, block_mean_square.size() / 5);
 	std::nth_element(block_mean_square.begin(), block_mean_square.begin() + num_top_blocks - 1, block_mean_square.end(), std::greater());
 	float average_mean_square = 0.f;
 	for (std::size_t i = 0; i < num_top_blocks; ++i) {
@@ -77,195 +599,597 @@ HWY_ATTR Rating::MonoRating ComputeMonoDR(SndfileHandle& input) {
 	std::nth_element(block_peak.begin(), block_peak.begin() + 1, block_peak.end(), std::greater());
 	const float peak = block_peak[std::min<std::size_t>(1, block_peak.size() - 1)];
 
-	return {10 * std::log10(peak * peak / average_mean_square)};
+	return 10 * std::log10(peak * peak / average_mean_square);
 }
 
-HWY_ATTR Rating::StereoRating ComputeStereoDR(SndfileHandle& input) {
-	HWY_FULL(float) d;
-	using V = decltype(hn::Zero(d));
-	const int block_size = GetBlockSize(input);
-	const auto num_blocks = std::max<std::size_t>(1, (input.frames() + block_size - 1) / block_size);
-	const auto num_top_blocks = std::max<std::size_t>(1, num_blocks / 5);
-	hwy::AlignedFreeUniquePtr<float[]> block_samples = hwy::AllocateAligned<float>(2 * block_size);
-	std::vector<float> left_block_mean_square;
-	std::vector<float> left_block_peak;
-	std::vector<float> right_block_mean_square;
-	std::vector<float> right_block_peak;
-	left_block_mean_square.reserve(num_blocks);
-	left_block_peak.reserve(num_blocks);
-	right_block_mean_square.reserve(num_blocks);
-	right_block_peak.reserve(num_blocks);
-
-	for (std::size_t i_block = 0; i_block < num_blocks; ++i_block) {
-		const std::size_t frames_read = input.readf(block_samples.get(), block_size);
-
-		V left_sums_of_squares = hn::Zero(d);
-		V right_sums_of_squares = hn::Zero(d);
-		V left_peaks = hn::Zero(d);
-		V right_peaks = hn::Zero(d);
-		std::size_t i;
-		for (i = 0; i + hn::Lanes(d) <= frames_read; i += hn::Lanes(d)) {
-			V left, right;
-			hn::LoadInterleaved2(d, &block_samples[2 * i], left, right);
-			left_sums_of_squares = hn::MulAdd(left, left, left_sums_of_squares);
-			right_sums_of_squares = hn::MulAdd(right, right, right_sums_of_squares);
-			left_peaks = hn::Max(left_peaks, hn::Abs(left));
-			right_peaks = hn::Max(right_peaks, hn::Abs(right));
-		}
-		if (i != frames_read) {
-			const std::size_t remaining = 2 * (frames_read - i);
-			const V a = hn::LoadNOr(hn::Zero(d), d, &block_samples[2 * i], std::min<std::size_t>(hn::Lanes(d), remaining));
-			const V b = remaining > hn::Lanes(d)
-				? hn::LoadNOr(hn::Zero(d), d, &block_samples[2 * i + hn::Lanes(d)], remaining - hn::Lanes(d))
-				: hn::Zero(d);
-			const V left = hn::ConcatEven(d, b, a);
-			const V right = hn::ConcatOdd(d, b, a);
-			left_sums_of_squares = hn::MulAdd(left, left, left_sums_of_squares);
-			right_sums_of_squares = hn::MulAdd(right, right, right_sums_of_squares);
-			left_peaks = hn::Max(left_peaks, hn::Abs(left));
-			right_peaks = hn::Max(right_peaks, hn::Abs(right));
-		}
-		const float left_sum_of_squares = hn::ReduceSum(d, left_sums_of_squares);
-		const float right_sum_of_squares = hn::ReduceSum(d, right_sums_of_squares);
-		left_block_mean_square.push_back(left_sum_of_squares / frames_read);
-		right_block_mean_square.push_back(right_sum_of_squares / frames_read);
-		left_block_peak.push_back(hn::ReduceMax(d, left_peaks));
-		right_block_peak.push_back(hn::ReduceMax(d, right_peaks));
-	}
-
-	std::nth_element(left_block_mean_square.begin(), left_block_mean_square.begin() + num_top_blocks - 1, left_block_mean_square.end(), std::greater());
-	std::nth_element(right_block_mean_square.begin(), right_block_mean_square.begin() + num_top_blocks - 1, right_block_mean_square.end(), std::greater());
-	float left_average_mean_square = 0.f;
-	float right_average_mean_square = 0.f;
-	for (std::size_t i = 0; i < num_top_blocks; ++i) {
-		left_average_mean_square += left_block_mean_square[i];
-		right_average_mean_square += right_block_mean_square[i];
+// Scalar counterpart of AccumulateRawSamples, for the few frames that
+// DrAccumulator stages.
+float UnpackRawSample(const std::uint8_t* bytes, const PcmLayout& layout) {
+	std::uint32_t bits;
+	std::memcpy(&bits, bytes, sizeof bits);
+	if (layout.big_endian != kBigEndianHost) {
+		bits = (bits >> 24) | ((bits >> 8) & 0xFF00) | ((bits << 8) & 0xFF0000) | (bits << 24);
 	}
-	left_average_mean_square *= 2.f / num_top_blocks;
-	right_average_mean_square *= 2.f / num_top_blocks;
-
-	std::nth_element(left_block_peak.begin(), left_block_peak.begin() + 1, left_block_peak.end(), std::greater());
-	std::nth_element(right_block_peak.begin(), right_block_peak.begin() + 1, right_block_peak.end(), std::greater());
-	const float left_peak = left_block_peak[std::min<std::size_t>(1, left_block_peak.size() - 1)];
-	const float right_peak = right_block_peak[std::min<std::size_t>(1, right_block_peak.size() - 1)];
-
-	return {
-		10 * std::log10(left_peak * left_peak / left_average_mean_square),
-		10 * std::log10(right_peak * right_peak / right_average_mean_square),
-	};
+	if (layout.encoding == PcmLayout::Encoding::kFloat) {
+		float value;
+		std::memcpy(&value, &bits, sizeof value);
+		return value;
+	}
+	return static_cast<float>(static_cast<std::int32_t>(bits)) * 0x1p-31f;
 }
 
-HWY_ATTR Rating::MultichannelRating ComputeMultichannelDR(SndfileHandle& input) {
-	HWY_FULL(float) d;
-	using V = decltype(hn::Zero(d));
-	static constexpr int kBatchSize = 256;
-	const int block_size = GetBlockSize(input);
-	const auto num_blocks = std::max<std::size_t>(1, (input.frames() + block_size - 1) / block_size);
-	const auto num_top_blocks = std::max<std::size_t>(1, num_blocks / 5);
+// Reads up to `frames_left` frames of `input` as `Sample`s and passes them to
+// `consume(samples, frames)` in chunks.
+template <typename Sample, typename Consume>
+void ReadFrames(SndfileHandle& input, sf_count_t frames_left, const Consume& consume, PipelineStalls* const stalls) {
 	const int num_channels = input.channels();
-	const int num_lanes = hn::Lanes(d);
-	hwy::AlignedFreeUniquePtr<float[]> block_samples = hwy::AllocateAligned<float>(kBatchSize * num_channels);
-	hwy::AlignedFreeUniquePtr<float[]> channel_block_samples = hwy::AllocateAligned<float>(kBatchSize);
-	hwy::AlignedFreeUniquePtr<float[]> channel_sums_of_squares = hwy::AllocateAligned<float>(num_lanes * num_channels);
-	hwy::AlignedFreeUniquePtr<float[]> channel_peaks = hwy::AllocateAligned<float>(num_lanes * num_channels);
-	std::vector<std::vector<float>> block_mean_square(num_channels);
-	std::vector<std::vector<float>> block_peak(num_channels);
-	for (int c = 0; c < num_channels; ++c) {
-		block_mean_square[c].reserve(num_blocks);
-		block_peak[c].reserve(num_blocks);
-	}
-
-	float* const HWY_RESTRICT interleaved = block_samples.get();
-	for (std::size_t i_block = 0; i_block < num_blocks; ++i_block) {
-		for (int c = 0; c < num_channels; ++c) {
-			hn::Store(hn::Zero(d), d, &channel_sums_of_squares[c * num_lanes]);
-			hn::Store(hn::Zero(d), d, &channel_peaks[c * num_lanes]);
-		}
-		int frames_read = 0;
-		while (frames_read < block_size) {
-			const int batch_size = input.readf(interleaved, std::min(block_size - frames_read, kBatchSize));
-			if (batch_size == 0) break;
-			for (int c = 0; c < num_channels; ++c) {
-				float* const HWY_RESTRICT deinterleaved = channel_block_samples.get();
-				for (int i = 0; i < batch_size; ++i) {
-					deinterleaved[i] = interleaved[i * num_channels + c];
-				}
-				V sums_of_squares = hn::Load(d, &channel_sums_of_squares[c * num_lanes]);
-				V peaks = hn::Load(d, &channel_peaks[c * num_lanes]);
-				hn::Foreach(d, deinterleaved, batch_size, hn::Zero(d), [&](auto d, const V samples) HWY_ATTR {
-					sums_of_squares = hn::MulAdd(samples, samples, sums_of_squares);
-					peaks = hn::Max(peaks, hn::Abs(samples));
-				});
-				hn::Store(sums_of_squares, d, &channel_sums_of_squares[c * num_lanes]);
-				hn::Store(peaks, d, &channel_peaks[c * num_lanes]);
-			}
-			frames_read += batch_size;
-		}
-		for (int c = 0; c < num_channels; ++c) {
-			const V sums_of_squares = hn::Load(d, &channel_sums_of_squares[c * num_lanes]);
-			const V peaks = hn::Load(d, &channel_peaks[c * num_lanes]);
-			const float sum_of_squares = hn::ReduceSum(d, sums_of_squares);
-			block_mean_square[c].push_back(sum_of_squares / frames_read);
-			block_peak[c].push_back(hn::ReduceMax(d, peaks));
+	const std::size_t buffer_frames = std::max<std::size_t>(1, kReadSize / num_channels);
+
+	if (!stalls) {
+		std::vector<Sample> buffer(buffer_frames * num_channels);
+		while (frames_left > 0) {
+			const sf_count_t frames_read = input.readf(buffer.data(), std::min<sf_count_t>(frames_left, buffer_frames));
+			if (frames_read <= 0) break;
+			consume(buffer.data(), frames_read);
+			frames_left -= frames_read;
 		}
+		return;
 	}
 
-	std::vector<float> ratings;
-	ratings.reserve(num_channels);
-	for (int c = 0; c < num_channels; ++c) {
-		std::nth_element(block_mean_square[c].begin(), block_mean_square[c].begin() + num_top_blocks - 1, block_mean_square[c].end(), std::greater());
-		float average_mean_square = 0.f;
-		for (std::size_t i = 0; i < num_top_blocks; ++i) {
-			average_mean_square += block_mean_square[c][i];
+	// A buffer with no frames ends the input.
+	BufferRing<Sample> ring(kPipelineDepth, buffer_frames * num_channels);
+	PipelineStalls range_stalls;
+	std::thread decoder([&] {
+		sf_count_t frames_read;
+		do {
+			Sample* const buffer = ring.Acquire(range_stalls.decoding);
+			frames_read = frames_left > 0 ? std::max<sf_count_t>(0, input.readf(buffer, std::min<sf_count_t>(frames_left, buffer_frames))) : 0;
+			frames_left -= frames_read;
+			ring.Publish(frames_read);
+		} while (frames_read > 0);
+	});
+	for (;;) {
+		std::ptrdiff_t frames;
+		const Sample* const buffer = ring.Next(frames, range_stalls.analysis);
+		if (frames == 0) break;
+		consume(buffer, frames);
+		ring.Release();
+	}
+	decoder.join();
+	*stalls += range_stalls;
+}
+
+template <typename Sample, typename Accumulator, typename Push>
+BlockStatistics ReadBlocks(SndfileHandle& input, const std::size_t num_blocks, Accumulator accumulator, const Push& push, PipelineStalls* const stalls, Meters* const meters) {
+	ReadFrames<Sample>(input, static_cast<sf_count_t>(num_blocks) * GetBlockSize(input.samplerate()), [&](const Sample* const samples, const std::size_t frames) {
+		push(accumulator, samples, frames);
+		if (meters) {
+			push(*meters, samples, frames);
 		}
-		average_mean_square *= 2.f / num_top_blocks;
+	}, stalls);
+	return accumulator.FinishBlocks();
+}
 
-		std::nth_element(block_peak[c].begin(), block_peak[c].begin() + 1, block_peak[c].end(), std::greater());
-		const float peak = block_peak[c][std::min<std::size_t>(1, block_peak.size() - 1)];
+template <typename Sample, typename Accumulator, typename Push>
+std::vector<BlockStatistics> ReadTracks(SndfileHandle& input, const std::vector<std::uint64_t>& track_starts, Accumulator accumulator, const Push& push, PipelineStalls* const stalls) {
+	const int num_channels = input.channels();
+	TrackSplitter splitter(track_starts);
+	std::vector<BlockStatistics> tracks;
+	ReadFrames<Sample>(input, input.frames(), [&](const Sample* const samples, const std::size_t frames) {
+		splitter.Split(frames, [&](const std::size_t offset, const std::size_t n) {
+			push(accumulator, &samples[offset * num_channels], n);
+		}, [&] {
+			tracks.push_back(accumulator.FinishBlocks());
+		});
+	}, stalls);
+	// Including tracks that would start past the end.
+	while (tracks.size() < track_starts.size()) {
+		tracks.push_back(accumulator.FinishBlocks());
+	}
+	return tracks;
+}
 
-		ratings.push_back(10 * std::log10(peak * peak / average_mean_square));
+// Calls `compute_range(i, first_block, end_block)` in parallel for
+// `num_ranges` consecutive ranges of blocks and concatenates the results, or
+// returns nothing if any range fails.
+template <typename ComputeRange>
+std::optional<BlockStatistics> ComputeRanges(const std::size_t num_blocks, const std::size_t num_ranges, const ComputeRange& compute_range) {
+	std::vector<std::optional<BlockStatistics>> range_statistics(num_ranges);
+	#pragma omp parallel for num_threads(num_ranges) if(num_ranges > 1)
+	for (std::size_t i = 0; i < num_ranges; ++i) {
+		range_statistics[i] = compute_range(i, i * num_blocks / num_ranges, (i + 1) * num_blocks / num_ranges);
 	}
-	return ratings;
+
+	if (!std::all_of(range_statistics.begin(), range_statistics.end(), [](const auto& statistics) { return statistics.has_value(); })) {
+		return std::nullopt;
+	}
+	BlockStatistics statistics = std::move(*range_statistics[0]);
+	for (std::size_t i = 1; i < num_ranges; ++i) {
+		statistics.Append(std::move(*range_statistics[i]));
+	}
+	return statistics;
+}
+
+// Calls `read(sample, accumulator, push)` with a value of the type in which to
+// read `input`, an accumulator for it, and how to push samples of that type to
+// it, or to Meters. Integer PCM is read as such, which avoids the conversion to
+// float and makes the sums of squares exact.
+template <typename Read>
+auto ReadAs(SndfileHandle& input, const Read& read) {
+	const int samplerate = input.samplerate();
+	const int num_channels = input.channels();
+	const auto read_left_aligned = [&](const int bits_per_sample) {
+		return read(int(), IntegerDrAccumulator(samplerate, num_channels, bits_per_sample), [](auto& accumulator, const int* samples, const std::size_t frames) {
+			accumulator.PushLeftAligned(samples, frames);
+		});
+	};
+	switch (input.format() & SF_FORMAT_SUBMASK) {
+		// Not as shorts, which libsndfile would scale to 16 bits, so that their
+		// clipping level and bit depth are those of 8-bit samples, as when they
+		// are mapped.
+		case SF_FORMAT_PCM_S8:
+		case SF_FORMAT_PCM_U8:
+			return read_left_aligned(8);
+		case SF_FORMAT_PCM_16:
+			return read(short(), IntegerDrAccumulator(samplerate, num_channels, 16), [](auto& accumulator, const short* samples, const std::size_t frames) {
+				accumulator.Push(samples, frames);
+			});
+		case SF_FORMAT_PCM_24:
+			return read_left_aligned(24);
+		default:
+			return read(float(), DrAccumulator(samplerate, num_channels), [](auto& accumulator, const float* samples, const std::size_t frames) {
+				accumulator.Push(samples, frames);
+			});
+	}
+}
+
+#ifdef SPEEDR_HAVE_MMAP
+// Maps the samples of `input`, opened from `filename`, if it is of a format
+// that stores them uncompressed, and if the mapping holds as many frames as
+// libsndfile finds, which a placeholder size followed by other chunks, for
+// instance, would not.
+std::optional<MappedPcm> Map(const std::string& filename, SndfileHandle& input) {
+	switch (input.format() & SF_FORMAT_TYPEMASK) {
+		case SF_FORMAT_WAV:
+		case SF_FORMAT_WAVEX:
+		case SF_FORMAT_RF64:
+		case SF_FORMAT_AIFF:
+		case SF_FORMAT_CAF:
+			break;
+		default:
+			return std::nullopt;
+	}
+	std::optional<MappedPcm> pcm = MappedPcm::Open(filename);
+	if (pcm && pcm->frames() != static_cast<std::uint64_t>(input.frames())) return std::nullopt;
+	return pcm;
+}
+#endif
+
+BlockStatistics ComputeBlockStatistics(SndfileHandle& input, const std::size_t num_blocks, PipelineStalls* const stalls, Meters* const meters = nullptr) {
+	return ReadAs(input, [&](auto sample, auto accumulator, const auto& push) {
+		return ReadBlocks<decltype(sample)>(input, num_blocks, std::move(accumulator), push, stalls, meters);
+	});
+}
+}
+
+void ConvertSamples(const std::int16_t* samples, const std::size_t count, float* converted) {
+	HWY_DYNAMIC_DISPATCH(ConvertInt16Samples)(samples, count, converted);
+}
+
+void ConvertSamples(const std::int32_t* samples, const std::size_t count, const int bits_per_sample, float* converted) {
+	HWY_DYNAMIC_DISPATCH(ConvertInt32Samples)(samples, count, bits_per_sample, converted);
+}
+
+void ConvertSamples(const std::uint8_t* bytes, const std::size_t count, const PcmLayout& layout, float* converted) {
+	HWY_DYNAMIC_DISPATCH(ConvertRawSamples)(bytes, count, layout, converted);
+}
+
+const char* KernelVariant() {
+	return hwy::TargetName(HWY_DYNAMIC_DISPATCH(Target)());
+}
+
+int GetBlockSize(const int samplerate) {
+	return std::lround(3.f * static_cast<float>(samplerate) * 44160.f / 44100);
 }
 
-Rating ComputeRating(SndfileHandle& input) {
-	switch (input.channels()) {
-		case 1: {
-			const Rating::MonoRating rating = ComputeMonoDR(input);
+void BlockStatistics::Append(BlockStatistics&& other) {
+	for (std::size_t c = 0; c < mean_square.size(); ++c) {
+		mean_square[c].insert(mean_square[c].end(), other.mean_square[c].begin(), other.mean_square[c].end());
+		peak[c].insert(peak[c].end(), other.peak[c].begin(), other.peak[c].end());
+	}
+	for (std::size_t c = 0; c < clipping.size(); ++c) {
+		clipping[c].insert(clipping[c].end(), other.clipping[c].begin(), other.clipping[c].end());
+	}
+	for (std::size_t c = 0; c < bits.size(); ++c) {
+		bits[c].insert(bits[c].end(), other.bits[c].begin(), other.bits[c].end());
+		sum[c].insert(sum[c].end(), other.sum[c].begin(), other.sum[c].end());
+	}
+}
+
+Rating Rating::FromBlockStatistics(BlockStatistics statistics) {
+	const std::size_t num_channels = statistics.mean_square.size();
+	std::vector<float> ratings;
+	ratings.reserve(num_channels);
+	for (std::size_t c = 0; c < num_channels; ++c) {
+		ratings.push_back(ComputeChannelRating(statistics.mean_square[c], statistics.peak[c]));
+	}
+	return FromChannelRatings(std::move(ratings));
+}
+
+Rating Rating::FromChannelRatings(std::vector<float> ratings) {
+	switch (ratings.size()) {
+		case 1:
 			return {
-				.raw_rating = rating,
-				.final_rating = std::round(rating.value),
+				.raw_rating = MonoRating{ratings[0]},
+				.final_rating = std::round(ratings[0]),
 			};
-		}
-		case 2: {
-			const Rating::StereoRating rating = ComputeStereoDR(input);
+		case 2:
 			return {
-				.raw_rating = rating,
-				.final_rating = std::round((rating.left + rating.right) / 2),
+				.raw_rating = StereoRating{ratings[0], ratings[1]},
+				.final_rating = std::round((ratings[0] + ratings[1]) / 2),
 			};
-		}
 		default: {
-			Rating::MultichannelRating rating = ComputeMultichannelDR(input);
-			const float mean = std::accumulate(rating.begin(), rating.end(), 0.f, std::plus()) / rating.size();
+			const float mean = std::accumulate(ratings.begin(), ratings.end(), 0.f, std::plus()) / ratings.size();
 			return {
-				.raw_rating = std::move(rating),
+				.raw_rating = std::move(ratings),
 				.final_rating = std::round(mean),
 			};
 		}
 	}
 }
 
+std::vector<float> Rating::ChannelRatings() const {
+	struct Visitor {
+		std::vector<float> operator()(const MonoRating& rating) const {
+			return {rating.value};
+		}
+		std::vector<float> operator()(const StereoRating& rating) const {
+			return {rating.left, rating.right};
+		}
+		std::vector<float> operator()(const MultichannelRating& rating) const {
+			return rating;
+		}
+	};
+	return std::visit(Visitor{}, raw_rating);
+}
+
+BlockStatistics ComputeBlockStatistics(const std::string& filename, SndfileHandle& input, const std::function<SndfileHandle()>& open, const int num_threads, PipelineStalls* const stalls, Meters* const meters) {
+	const std::size_t num_blocks = GetNumBlocks(input);
+	const std::size_t num_ranges = meters ? 1 : GetNumRanges(num_blocks, num_threads);
+	const std::size_t block_size = GetBlockSize(input.samplerate());
+
+#ifdef SPEEDR_HAVE_FLAC
+	if ((input.format() & SF_FORMAT_TYPEMASK) == SF_FORMAT_FLAC) {
+		std::optional<BlockStatistics> statistics = ComputeRanges(num_blocks, num_ranges, [&](std::size_t, const std::size_t first_block, const std::size_t end_block) {
+			return ComputeFlacBlockStatistics(filename, first_block * block_size, end_block * block_size, meters);
+		});
+		// Streams in which libFLAC cannot seek, e.g. without a seektable or a
+		// known length, can still be decoded natively as a single range.
+		if (!statistics && num_ranges > 1) {
+			statistics = ComputeFlacBlockStatistics(filename, 0, num_blocks * block_size, meters);
+		}
+		if (statistics) {
+			return std::move(*statistics);
+		}
+		if (meters) {
+			meters->Restart();
+		}
+	}
+#endif
+
+#ifdef SPEEDR_HAVE_MMAP
+	if (const std::optional<MappedPcm> pcm = Map(filename, input)) {
+		const std::size_t pcm_block_size = GetBlockSize(pcm->samplerate());
+		const std::size_t pcm_num_blocks = GetNumBlocks(pcm->frames(), pcm->samplerate());
+		// The meters follow the whole mapping on a thread of their own if that
+		// leaves enough threads to split it, or else alongside its only range.
+		const std::size_t pcm_num_ranges = GetNumRanges(pcm_num_blocks, meters ? num_threads - 1 : num_threads);
+		Meters* const range_meters = pcm_num_ranges > 1 ? nullptr : meters;
+		std::thread metering;
+		if (meters && !range_meters) {
+			metering = std::thread([&] { pcm->Meter(*meters); });
+		}
+		BlockStatistics statistics = *ComputeRanges(pcm_num_blocks, pcm_num_ranges, [&](std::size_t, const std::size_t first_block, const std::size_t end_block) {
+			return std::optional(pcm->ComputeBlockStatistics(first_block * pcm_block_size, end_block * pcm_block_size, range_meters));
+		});
+		if (metering.joinable()) {
+			metering.join();
+		}
+		return statistics;
+	}
+#endif
+
+	if (num_ranges == 1 || !input.seekable()) {
+		return ComputeBlockStatistics(input, num_blocks, stalls, meters);
+	}
+
+	std::vector<SndfileHandle> handles;
+	handles.reserve(num_ranges);
+	handles.push_back(input);
+	while (handles.size() < num_ranges) {
+		SndfileHandle handle = open();
+		if (!handle.rawHandle() || !handle.seekable()) {
+			return ComputeBlockStatistics(input, num_blocks, stalls);
+		}
+		handles.push_back(std::move(handle));
+	}
+
+	std::vector<PipelineStalls> range_stalls(num_ranges);
+	std::optional<BlockStatistics> statistics = ComputeRanges(num_blocks, num_ranges, [&](const std::size_t i, const std::size_t first_block, const std::size_t end_block) {
+		handles[i].seek(static_cast<sf_count_t>(first_block * block_size), SEEK_SET);
+		return std::optional(ComputeBlockStatistics(handles[i], end_block - first_block, stalls ? &range_stalls[i] : nullptr));
+	});
+	if (stalls) {
+		for (const PipelineStalls& range: range_stalls) {
+			*stalls += range;
+		}
+	}
+	return std::move(*statistics);
+}
+
+std::vector<BlockStatistics> ComputeTrackBlockStatistics(const std::string& filename, SndfileHandle& input, const std::vector<std::uint64_t>& track_starts, PipelineStalls* const stalls) {
+#ifdef SPEEDR_HAVE_FLAC
+	if ((input.format() & SF_FORMAT_TYPEMASK) == SF_FORMAT_FLAC) {
+		if (std::optional<std::vector<BlockStatistics>> tracks = ComputeFlacTrackBlockStatistics(filename, track_starts)) {
+			return std::move(*tracks);
+		}
+	}
+#endif
+
+#ifdef SPEEDR_HAVE_MMAP
+	if (const std::optional<MappedPcm> pcm = Map(filename, input)) {
+		std::vector<BlockStatistics> tracks;
+		tracks.reserve(track_starts.size());
+		for (std::size_t i = 0; i < track_starts.size(); ++i) {
+			tracks.push_back(pcm->ComputeBlockStatistics(track_starts[i], i + 1 < track_starts.size() ? track_starts[i + 1] : pcm->frames()));
+		}
+		return tracks;
+	}
+#endif
+
+	return ReadAs(input, [&](auto sample, auto accumulator, const auto& push) {
+		return ReadTracks<decltype(sample)>(input, track_starts, std::move(accumulator), push, stalls);
+	});
+}
+
+void StreamBlockStatistics(SndfileHandle& input, const std::function<void(const BlockStatistics&)>& on_blocks, PipelineStalls* const stalls) {
+	ReadAs(input, [&](auto sample, auto accumulator, const auto& push) {
+		using Sample = decltype(sample);
+		ReadFrames<Sample>(input, std::numeric_limits<sf_count_t>::max(), [&](const Sample* const samples, const std::size_t frames) {
+			push(accumulator, samples, frames);
+			const BlockStatistics statistics = accumulator.TakeBlocks();
+			if (!statistics.mean_square[0].empty()) {
+				on_blocks(statistics);
+			}
+		}, stalls);
+	});
 }
+
+std::vector<Rating> Rating::Compute(const std::string& filename, SndfileHandle& input, const std::vector<std::uint64_t>& track_starts, PipelineStalls* const stalls) {
+	std::vector<Rating> ratings;
+	for (BlockStatistics& statistics: ComputeTrackBlockStatistics(filename, input, track_starts, stalls)) {
+		ratings.push_back(FromBlockStatistics(std::move(statistics)));
+	}
+	return ratings;
 }
 
-#if HWY_ONCE
+DrAccumulator::DrAccumulator(const int samplerate, const int num_channels)
+	: num_channels_(num_channels),
+	  block_size_(GetBlockSize(samplerate)),
+	  num_positions_(std::lcm(HWY_DYNAMIC_DISPATCH(NumLanes)(), static_cast<std::size_t>(num_channels))),
+	  period_frames_(num_positions_ / num_channels),
+	  sums_of_squares_(hwy::AllocateAligned<float>(num_positions_)),
+	  peaks_(hwy::AllocateAligned<float>(num_positions_)),
+	  clipping_(num_channels),
+	  staged_(hwy::AllocateAligned<float>(num_positions_)) {
+	std::fill_n(sums_of_squares_.get(), num_positions_, 0.f);
+	std::fill_n(peaks_.get(), num_positions_, 0.f);
+	statistics_.mean_square.resize(num_channels);
+	statistics_.peak.resize(num_channels);
+	statistics_.clipping.resize(num_channels);
+}
 
-namespace {
-HWY_EXPORT(ComputeRating);
+template <typename Accumulate, typename Stage>
+void DrAccumulator::PushFrames(const std::size_t frames, const Accumulate& accumulate, const Stage& stage) {
+	std::size_t offset = 0;
+	while (offset < frames) {
+		const std::size_t frames_left = frames - offset;
+		const std::size_t block_room = block_size_ - frames_in_block_ - num_staged_;
+		std::size_t n = 0;
+		if (num_staged_ == 0) {
+			// Whole periods, or the rest of the block, need no staging.
+			n = std::min(frames_left, block_room);
+			if (n < block_room) {
+				n -= n % period_frames_;
+			}
+			if (n > 0) {
+				accumulate(offset, n);
+				frames_in_block_ += n;
+			}
+		}
+		if (n == 0) {
+			n = std::min({frames_left, period_frames_ - num_staged_, block_room});
+			stage(offset, n, &staged_[num_staged_ * num_channels_]);
+			num_staged_ += n;
+			if (num_staged_ == period_frames_ || n == block_room) {
+				AccumulateStaged();
+			}
+		}
+		offset += n;
+		if (frames_in_block_ == block_size_) {
+			EndBlock();
+		}
+	}
+}
+
+void DrAccumulator::Push(const float* interleaved, const std::size_t frames) {
+	PushFrames(frames, [&](const std::size_t offset, const std::size_t n) {
+		HWY_DYNAMIC_DISPATCH(AccumulateFloatSamples)(&interleaved[offset * num_channels_], n * num_channels_, num_channels_, num_positions_, sums_of_squares_.get(), peaks_.get(), clipping_.data());
+	}, [&](const std::size_t offset, const std::size_t n, float* const staged) {
+		std::copy_n(&interleaved[offset * num_channels_], n * num_channels_, staged);
+	});
+}
+
+void DrAccumulator::Push(const std::uint8_t* interleaved, const std::size_t frames, const PcmLayout& layout) {
+	const std::size_t frame_size = num_channels_ * layout.bytes_per_sample;
+	PushFrames(frames, [&](const std::size_t offset, const std::size_t n) {
+		HWY_DYNAMIC_DISPATCH(AccumulateRawSamples)(&interleaved[offset * frame_size], n * num_channels_, layout, num_channels_, num_positions_, sums_of_squares_.get(), peaks_.get(), clipping_.data());
+	}, [&](const std::size_t offset, const std::size_t n, float* const staged) {
+		for (std::size_t i = 0; i < n * num_channels_; ++i) {
+			staged[i] = UnpackRawSample(&interleaved[offset * frame_size + i * layout.bytes_per_sample], layout);
+		}
+	});
 }
 
-Rating Rating::Compute(SndfileHandle& input) {
-	return HWY_DYNAMIC_DISPATCH(ComputeRating)(input);
+BlockStatistics DrAccumulator::FinishBlocks() {
+	AccumulateStaged();
+	if (frames_in_block_ > 0 || statistics_.mean_square[0].empty()) {
+		EndBlock();
+	}
+	return TakeBlocks();
+}
+
+Rating DrAccumulator::Finish() {
+	return Rating::FromBlockStatistics(FinishBlocks());
+}
+
+BlockStatistics DrAccumulator::TakeBlocks() {
+	BlockStatistics statistics = std::move(statistics_);
+	statistics_.mean_square.assign(num_channels_, {});
+	statistics_.peak.assign(num_channels_, {});
+	statistics_.clipping.assign(num_channels_, {});
+	return statistics;
+}
+
+void DrAccumulator::AccumulateStaged() {
+	if (num_staged_ == 0) return;
+	HWY_DYNAMIC_DISPATCH(AccumulateFloatSamples)(staged_.get(), num_staged_ * num_channels_, num_channels_, num_positions_, sums_of_squares_.get(), peaks_.get(), clipping_.data());
+	frames_in_block_ += num_staged_;
+	num_staged_ = 0;
+}
+
+void DrAccumulator::EndBlock() {
+	for (int c = 0; c < num_channels_; ++c) {
+		float sum_of_squares = 0.f;
+		float peak = 0.f;
+		for (std::size_t position = c; position < num_positions_; position += num_channels_) {
+			sum_of_squares += sums_of_squares_[position];
+			peak = std::max(peak, peaks_[position]);
+		}
+		statistics_.mean_square[c].push_back(sum_of_squares / frames_in_block_);
+		statistics_.peak[c].push_back(peak);
+		statistics_.clipping[c].push_back(clipping_[c].block);
+	}
+	std::fill_n(sums_of_squares_.get(), num_positions_, 0.f);
+	std::fill_n(peaks_.get(), num_positions_, 0.f);
+	std::fill(clipping_.begin(), clipping_.end(), ClippingTracker());
+	frames_in_block_ = 0;
+}
+
+IntegerDrAccumulator::IntegerDrAccumulator(const int samplerate, const int num_channels, const int bits_per_sample)
+	: num_channels_(num_channels),
+	  block_size_(GetBlockSize(samplerate)),
+	  num_lanes_(HWY_DYNAMIC_DISPATCH(NumLanes)()),
+	  num_positions_(std::lcm(num_lanes_, static_cast<std::size_t>(num_channels))),
+	  bits_per_sample_(bits_per_sample),
+	  sums_of_squares_(num_channels),
+	  peaks_(num_channels),
+	  bits_(num_channels),
+	  sums_(num_channels),
+	  clipping_(num_channels),
+	  // Rounded up, like the level that floats would be compared to.
+	  clipping_level_(static_cast<std::int32_t>(std::ceil(std::ldexp(double{kClippingLevel}, bits_per_sample - 1)))) {
+	statistics_.mean_square.resize(num_channels);
+	statistics_.peak.resize(num_channels);
+	statistics_.clipping.resize(num_channels);
+	statistics_.bits.resize(num_channels);
+	statistics_.sum.resize(num_channels);
+}
+
+template <typename Accumulate>
+void IntegerDrAccumulator::PushBlockSegments(const std::size_t frames, const Accumulate& accumulate) {
+	std::size_t offset = 0;
+	while (offset < frames) {
+		const std::size_t n = std::min(frames - offset, block_size_ - frames_in_block_);
+		accumulate(offset, n);
+		frames_in_block_ += n;
+		offset += n;
+		if (frames_in_block_ == block_size_) {
+			EndBlock();
+		}
+	}
+}
+
+void IntegerDrAccumulator::Push(const std::int16_t* interleaved, const std::size_t frames) {
+	PushBlockSegments(frames, [&](const std::size_t offset, const std::size_t n) {
+		HWY_DYNAMIC_DISPATCH(AccumulateInt16Samples)(&interleaved[offset * num_channels_], n * num_channels_, num_channels_, num_positions_, clipping_level_, sums_of_squares_.data(), peaks_.data(), bits_.data(), sums_.data(), clipping_.data());
+	});
+}
+
+void IntegerDrAccumulator::Push(const std::int32_t* interleaved, const std::size_t frames) {
+	PushBlockSegments(frames, [&](const std::size_t offset, const std::size_t n) {
+		HWY_DYNAMIC_DISPATCH(AccumulateInt32Samples)(&interleaved[offset * num_channels_], n * num_channels_, 0, num_channels_, num_positions_, clipping_level_, sums_of_squares_.data(), peaks_.data(), bits_.data(), sums_.data(), clipping_.data());
+	});
+}
+
+void IntegerDrAccumulator::PushLeftAligned(const std::int32_t* interleaved, const std::size_t frames) {
+	PushBlockSegments(frames, [&](const std::size_t offset, const std::size_t n) {
+		HWY_DYNAMIC_DISPATCH(AccumulateInt32Samples)(&interleaved[offset * num_channels_], n * num_channels_, 32 - bits_per_sample_, num_channels_, num_positions_, clipping_level_, sums_of_squares_.data(), peaks_.data(), bits_.data(), sums_.data(), clipping_.data());
+	});
+}
+
+void IntegerDrAccumulator::Push(const std::uint8_t* interleaved, const std::size_t frames, const PcmLayout& layout) {
+	const std::size_t frame_size = num_channels_ * layout.bytes_per_sample;
+	PushBlockSegments(frames, [&](const std::size_t offset, const std::size_t n) {
+		HWY_DYNAMIC_DISPATCH(AccumulateRawIntegerSamples)(&interleaved[offset * frame_size], n * num_channels_, layout, num_channels_, num_positions_, clipping_level_, sums_of_squares_.data(), peaks_.data(), bits_.data(), sums_.data(), clipping_.data());
+	});
+}
+
+void IntegerDrAccumulator::PushPlanar(const std::int32_t* const* channels, const std::size_t frames) {
+	PushBlockSegments(frames, [&](const std::size_t offset, const std::size_t n) {
+		for (int c = 0; c < num_channels_; ++c) {
+			HWY_DYNAMIC_DISPATCH(AccumulateInt32Samples)(&channels[c][offset], n, 0, 1, num_lanes_, clipping_level_, &sums_of_squares_[c], &peaks_[c], &bits_[c], &sums_[c], &clipping_[c]);
+		}
+	});
+}
+
+BlockStatistics IntegerDrAccumulator::FinishBlocks() {
+	if (frames_in_block_ > 0 || statistics_.mean_square[0].empty()) {
+		EndBlock();
+	}
+	return TakeBlocks();
+}
+
+Rating IntegerDrAccumulator::Finish() {
+	return Rating::FromBlockStatistics(FinishBlocks());
+}
+
+BlockStatistics IntegerDrAccumulator::TakeBlocks() {
+	BlockStatistics statistics = std::move(statistics_);
+	statistics_.mean_square.assign(num_channels_, {});
+	statistics_.peak.assign(num_channels_, {});
+	statistics_.clipping.assign(num_channels_, {});
+	statistics_.bits.assign(num_channels_, {});
+	statistics_.sum.assign(num_channels_, {});
+	return statistics;
+}
+
+void IntegerDrAccumulator::EndBlock() {
+	// Scales samples to [-1, 1), like libsndfile does when reading floats.
+	const double scale = std::ldexp(1., 1 - bits_per_sample_);
+	for (int c = 0; c < num_channels_; ++c) {
+		statistics_.mean_square[c].push_back(sums_of_squares_[c].ToDouble() * scale * scale / frames_in_block_);
+		statistics_.peak[c].push_back(peaks_[c] * scale);
+		statistics_.clipping[c].push_back(clipping_[c].block);
+		statistics_.bits[c].push_back(bits_[c] << (32 - bits_per_sample_));
+		statistics_.sum[c].push_back(sums_[c] * scale);
+	}
+	std::fill(sums_of_squares_.begin(), sums_of_squares_.end(), ExactSum());
+	std::fill(peaks_.begin(), peaks_.end(), 0);
+	std::fill(bits_.begin(), bits_.end(), 0);
+	std::fill(sums_.begin(), sums_.end(), 0);
+	std::fill(clipping_.begin(), clipping_.end(), ClippingTracker());
+	frames_in_block_ = 0;
 }
 
 #endif
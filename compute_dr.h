@@ -15,13 +15,112 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
+#include <hwy/aligned_allocator.h>
 #include <sndfile.hh>
 
 namespace speedr {
 
+class Meters;
+
+// Number of frames in each block over which the RMS and peak are measured.
+int GetBlockSize(int samplerate);
+
+// Name of the SIMD target that the kernels run on, which can affect the last
+// digits of ratings computed from floats.
+const char* KernelVariant();
+
+// Samples at least this far from zero count as clipped: the largest 16-bit
+// sample, which wider samples only exceed within 2^-15 of full scale.
+inline constexpr float kClippingLevel = 32767.f / 32768;
+// Consecutive clipped samples of a channel that make a run.
+inline constexpr std::uint32_t kMinClippingRun = 3;
+
+// Clipped samples of a channel within a block. Runs that start or end the
+// block can go on in the neighbouring blocks, so they are kept apart.
+struct ClippedSamples {
+	std::uint32_t count = 0;
+	// Runs of at least kMinClippingRun samples in the middle of the block.
+	std::uint32_t runs = 0;
+	// Clipped samples at the start and at the end of the block, which are
+	// both all of them if the whole block is clipped.
+	std::uint32_t head = 0;
+	std::uint32_t tail = 0;
+};
+
+// Follows the clipped samples of a channel through a block.
+struct ClippingTracker {
+	ClippedSamples block;
+	// Whether a sample of the block is not clipped, which ends its head.
+	bool unclipped = false;
+
+	// For the next sample, which is counted separately.
+	void Add(const bool clipped) {
+		if (clipped) {
+			++block.tail;
+			block.head += !unclipped;
+			return;
+		}
+		if (unclipped && block.tail >= kMinClippingRun) {
+			++block.runs;
+		}
+		block.tail = 0;
+		unclipped = true;
+	}
+};
+
+struct BlockStatistics {
+	// Indexed by channel, then by block.
+	std::vector<std::vector<float>> mean_square;
+	std::vector<std::vector<float>> peak;
+	std::vector<std::vector<ClippedSamples>> clipping;
+	// Only of samples read as integers, and empty otherwise: the bitwise OR of
+	// the samples of each block, left-aligned in 32 bits, and their sum, with
+	// samples scaled to [-1, 1).
+	std::vector<std::vector<std::uint32_t>> bits;
+	std::vector<std::vector<double>> sum;
+
+	// Appends the blocks of `other`, which must directly follow those of `*this`.
+	void Append(BlockStatistics&& other);
+};
+
+// Unsigned 128-bit integer, so that sums of squares of integer samples are
+// exact regardless of the block size.
+struct ExactSum {
+	std::uint64_t low = 0;
+	std::uint64_t high = 0;
+
+	void Add(const std::uint64_t value) {
+		low += value;
+		high += low < value;
+	}
+	double ToDouble() const {
+		return std::ldexp(static_cast<double>(high), 64) + static_cast<double>(low);
+	}
+};
+
+// Time spent by each side of a pipelined decode waiting for the other, in
+// seconds: the decoder for a free buffer, the analysis for decoded samples.
+struct PipelineStalls {
+	double decoding = 0;
+	double analysis = 0;
+
+	PipelineStalls& operator+=(const PipelineStalls& other) {
+		decoding += other.decoding;
+		analysis += other.analysis;
+		return *this;
+	}
+};
+
 struct Rating {
 	struct MonoRating {
 		float value;
@@ -34,7 +133,188 @@ struct Rating {
 
 	float final_rating;
 	
-	static Rating Compute(SndfileHandle& input);
+	// Rates each of the consecutive tracks of a disc image, which start at
+	// `track_starts` (see TrackSplitter), in a single pass over `input`, with
+	// the same results as if they had been split into files of their own.
+	static std::vector<Rating> Compute(const std::string& filename, SndfileHandle& input, const std::vector<std::uint64_t>& track_starts, PipelineStalls* stalls = nullptr);
+	static Rating FromBlockStatistics(BlockStatistics statistics);
+	// From the raw rating of each channel, in order.
+	static Rating FromChannelRatings(std::vector<float> ratings);
+
+	std::vector<float> ChannelRatings() const;
+};
+
+// Splits `input`, opened from `filename`, into up to `num_threads` ranges of
+// whole blocks, each read through its own handle obtained from `open`. The
+// result is identical to that of a single range, which is read instead for
+// inputs that are not seekable or too short to be worth splitting. When speedr
+// is built with libFLAC, FLAC inputs are instead decoded natively, also in
+// ranges of blocks if `num_threads` allows. If `stalls` is given, the samples
+// that are still read through libsndfile are decoded on a separate thread, a
+// few buffers ahead of their analysis, and the time that either side spends
+// waiting for the other is added to `*stalls`. Also feeds `meters`, if any, the
+// samples of the whole input. Since the meters follow it from start to end, the
+// input is then read as a single range, unless it is mapped into memory and can
+// be metered on a thread of its own.
+BlockStatistics ComputeBlockStatistics(const std::string& filename, SndfileHandle& input, const std::function<SndfileHandle()>& open, int num_threads, PipelineStalls* stalls = nullptr, Meters* meters = nullptr);
+// Reads `input` to its end, which need not be known in advance, and calls
+// `on_blocks(statistics)` with the blocks completed by each read, as soon as
+// they are. A partial last block is left out.
+void StreamBlockStatistics(SndfileHandle& input, const std::function<void(const BlockStatistics&)>& on_blocks, PipelineStalls* stalls = nullptr);
+
+// One per track, for Rating::Compute, which rates disc images.
+std::vector<BlockStatistics> ComputeTrackBlockStatistics(const std::string& filename, SndfileHandle& input, const std::vector<std::uint64_t>& track_starts, PipelineStalls* stalls = nullptr);
+
+// Finds where the consecutive tracks of a single input, such as a disc image,
+// begin among frames passed in chunks of any size.
+class TrackSplitter {
+public:
+	// `track_starts` holds the first frame of each track, in increasing order
+	// and starting with 0.
+	explicit TrackSplitter(std::vector<std::uint64_t> track_starts) : track_starts_(std::move(track_starts)) {}
+
+	// Calls `push(offset, n)` for each run of the next `frames` frames that
+	// lies within a single track, and `end_track()` between the runs of two
+	// tracks.
+	template <typename Push, typename EndTrack>
+	void Split(const std::size_t frames, const Push& push, const EndTrack& end_track) {
+		std::size_t offset = 0;
+		while (offset < frames) {
+			if (next_track_ < track_starts_.size() && position_ >= track_starts_[next_track_]) {
+				end_track();
+				++next_track_;
+				continue;
+			}
+			std::size_t n = frames - offset;
+			if (next_track_ < track_starts_.size()) {
+				n = std::min<std::uint64_t>(n, track_starts_[next_track_] - position_);
+			}
+			push(offset, n);
+			offset += n;
+			position_ += n;
+		}
+	}
+
+private:
+	std::vector<std::uint64_t> track_starts_;
+	// The first track starts without ending any.
+	std::size_t next_track_ = 1;
+	std::uint64_t position_ = 0;
+};
+
+// How raw interleaved samples are stored, e.g. in an uncompressed file.
+struct PcmLayout {
+	enum class Encoding {
+		kSignedInteger,
+		kUnsignedInteger,
+		kFloat,
+	};
+	Encoding encoding;
+	int bytes_per_sample;
+	bool big_endian;
+};
+
+constexpr bool kBigEndianHost = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+
+// Converts `count` samples to floats, scaled as the accumulators below scale
+// them, for other analyses of the same reads.
+void ConvertSamples(const std::int16_t* samples, std::size_t count, float* converted);
+// For integers within ±2^(bits_per_sample - 1), e.g. left-aligned if 32.
+void ConvertSamples(const std::int32_t* samples, std::size_t count, int bits_per_sample, float* converted);
+// For any of the layouts of PcmLayout.
+void ConvertSamples(const std::uint8_t* bytes, std::size_t count, const PcmLayout& layout, float* converted);
+
+// Computes a rating from interleaved samples pushed in chunks of any size, for
+// audio that does not come from a SndfileHandle. The result does not depend on
+// how the samples are split across calls to `Push`.
+class DrAccumulator {
+public:
+	DrAccumulator(int samplerate, int num_channels);
+
+	void Push(const float* interleaved, std::size_t frames);
+	// For 32-bit floats or integers, of either endianness, as stored in
+	// `layout`. Integers are scaled to [-1, 1).
+	void Push(const std::uint8_t* interleaved, std::size_t frames, const PcmLayout& layout);
+	// Ends the last block, even if partial, and returns the blocks pushed so
+	// far. Frames pushed afterwards are analysed as if by a new accumulator,
+	// e.g. as the next track of a disc image.
+	BlockStatistics FinishBlocks();
+	Rating Finish();
+	// Returns the blocks completed so far, without ending the current one, for
+	// analyses that follow the samples as they come.
+	BlockStatistics TakeBlocks();
+
+private:
+	// Calls `accumulate(offset, n)` for frames that fill whole periods or end
+	// a block, and `stage(offset, n, staged)` to copy the others as floats.
+	template <typename Accumulate, typename Stage>
+	void PushFrames(std::size_t frames, const Accumulate& accumulate, const Stage& stage);
+	void AccumulateStaged();
+	void EndBlock();
+
+	int num_channels_;
+	std::size_t block_size_;
+	// Least common multiple of the number of lanes and of channels, such that
+	// each position within a period of interleaved samples always belongs to
+	// the same channel.
+	std::size_t num_positions_;
+	std::size_t period_frames_;
+	// Per-position sums of squares and peaks of the current block.
+	hwy::AlignedFreeUniquePtr<float[]> sums_of_squares_;
+	hwy::AlignedFreeUniquePtr<float[]> peaks_;
+	// Of the current block, for each channel.
+	std::vector<ClippingTracker> clipping_;
+	std::size_t frames_in_block_ = 0;
+	// Frames that do not yet fill a whole period.
+	hwy::AlignedFreeUniquePtr<float[]> staged_;
+	std::size_t num_staged_ = 0;
+	BlockStatistics statistics_;
+};
+
+// Like DrAccumulator, but for integer samples with `bits_per_sample`
+// significant bits (at most 24), whose squares are summed exactly. Since
+// integer sums do not depend on the order of the samples, neither does the
+// result.
+class IntegerDrAccumulator {
+public:
+	IntegerDrAccumulator(int samplerate, int num_channels, int bits_per_sample);
+
+	void Push(const std::int16_t* interleaved, std::size_t frames);
+	// Samples lie within ±2^(bits_per_sample - 1).
+	void Push(const std::int32_t* interleaved, std::size_t frames);
+	// Samples occupy the most significant bits of each int32, as returned by
+	// libsndfile.
+	void PushLeftAligned(const std::int32_t* interleaved, std::size_t frames);
+	// One buffer per channel, with samples as in `Push`.
+	void PushPlanar(const std::int32_t* const* channels, std::size_t frames);
+	// For integers of at most 3 bytes, signed or unsigned (8-bit only) and of
+	// either endianness, as stored in `layout`, whose size should match
+	// `bits_per_sample`.
+	void Push(const std::uint8_t* interleaved, std::size_t frames, const PcmLayout& layout);
+	BlockStatistics FinishBlocks();
+	Rating Finish();
+	BlockStatistics TakeBlocks();
+
+private:
+	template <typename Accumulate>
+	void PushBlockSegments(std::size_t frames, const Accumulate& accumulate);
+	void EndBlock();
+
+	int num_channels_;
+	std::size_t block_size_;
+	std::size_t num_lanes_;
+	std::size_t num_positions_;
+	int bits_per_sample_;
+	// Of the current block, for each channel.
+	std::vector<ExactSum> sums_of_squares_;
+	std::vector<std::int32_t> peaks_;
+	std::vector<std::uint32_t> bits_;
+	std::vector<std::int64_t> sums_;
+	std::vector<ClippingTracker> clipping_;
+	// Samples at least this far from zero are clipped.
+	std::int32_t clipping_level_;
+	std::size_t frames_in_block_ = 0;
+	BlockStatistics statistics_;
 };
 
 }
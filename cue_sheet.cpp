@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cue_sheet.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+
+#ifdef SPEEDR_HAVE_FLAC
+#include <FLAC/metadata.h>
+#endif
+
+namespace speedr {
+
+namespace {
+
+// Splits a line of a CUE file into its command and arguments, which may be
+// quoted.
+std::vector<std::string> Tokenize(const std::string& line) {
+	std::vector<std::string> tokens;
+	std::size_t i = 0;
+	while (i < line.size()) {
+		if (std::isspace(static_cast<unsigned char>(line[i]))) {
+			++i;
+			continue;
+		}
+		if (line[i] == '"') {
+			const std::size_t end = std::min(line.find('"', i + 1), line.size());
+			tokens.push_back(line.substr(i + 1, end - i - 1));
+			i = end + 1;
+			continue;
+		}
+		std::size_t end = i;
+		while (end < line.size() && !std::isspace(static_cast<unsigned char>(line[end]))) {
+			++end;
+		}
+		tokens.push_back(line.substr(i, end - i));
+		i = end;
+	}
+	return tokens;
+}
+
+// In CD frames, from mm:ss:ff.
+std::optional<std::uint64_t> ParseTime(const std::string& time) {
+	unsigned minutes, seconds, frames;
+	char end;
+	if (std::sscanf(time.c_str(), "%u:%u:%u%c", &minutes, &seconds, &frames, &end) != 3 || seconds >= 60 || frames >= 75) {
+		return std::nullopt;
+	}
+	return (std::uint64_t{minutes} * 60 + seconds) * 75 + frames;
+}
+
+#ifdef SPEEDR_HAVE_FLAC
+struct MetadataDeleter {
+	void operator()(FLAC__StreamMetadata* metadata) const {
+		FLAC__metadata_object_delete(metadata);
+	}
+};
+#endif
+
+}
+
+std::vector<std::uint64_t> CueSheet::TrackStarts(const int samplerate) const {
+	std::vector<std::uint64_t> starts;
+	starts.reserve(tracks.size());
+	for (const CueTrack& track: tracks) {
+		starts.push_back(starts.empty() ? 0 : track.start * samplerate / start_rate);
+	}
+	return starts;
+}
+
+bool IsCueFilename(const std::string& filename) {
+	std::string extension = std::filesystem::path(filename).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) { return std::tolower(c); });
+	return extension == ".cue";
+}
+
+std::optional<CueSheet> ReadCueSheet(const std::string& filename) {
+	std::ifstream file(filename);
+	if (!file) return std::nullopt;
+
+	CueSheet sheet;
+	std::string line;
+	bool first_line = true;
+	while (std::getline(file, line)) {
+		if (first_line && line.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+			line.erase(0, 3);
+		}
+		first_line = false;
+		const std::vector<std::string> tokens = Tokenize(line);
+		if (tokens.empty()) continue;
+		const std::string& command = tokens[0];
+		if (command == "FILE") {
+			if (tokens.size() < 2 || !sheet.image_filename.empty()) return std::nullopt;
+			sheet.image_filename = (std::filesystem::path(filename).parent_path() / tokens[1]).string();
+		}
+		else if (command == "TRACK") {
+			if (tokens.size() < 3 || tokens[2] != "AUDIO" || sheet.image_filename.empty()) return std::nullopt;
+			sheet.tracks.push_back(CueTrack{
+				.number = std::atoi(tokens[1].c_str()),
+				.start = std::numeric_limits<std::uint64_t>::max(),
+			});
+		}
+		else if (command == "TITLE" && tokens.size() >= 2 && !sheet.tracks.empty()) {
+			sheet.tracks.back().title = tokens[1];
+		}
+		else if (command == "INDEX" && tokens.size() >= 3 && std::atoi(tokens[1].c_str()) == 1) {
+			const std::optional<std::uint64_t> start = ParseTime(tokens[2]);
+			if (sheet.tracks.empty() || !start) return std::nullopt;
+			sheet.tracks.back().start = *start;
+		}
+	}
+
+	if (sheet.tracks.empty()) return std::nullopt;
+	for (std::size_t i = 0; i < sheet.tracks.size(); ++i) {
+		if (sheet.tracks[i].start == std::numeric_limits<std::uint64_t>::max() || (i > 0 && sheet.tracks[i].start <= sheet.tracks[i - 1].start)) {
+			return std::nullopt;
+		}
+	}
+	return sheet;
+}
+
+#ifdef SPEEDR_HAVE_FLAC
+std::optional<CueSheet> ReadFlacCueSheet(const std::string& filename) {
+	FLAC__StreamMetadata stream_info;
+	FLAC__StreamMetadata* metadata;
+	if (!FLAC__metadata_get_streaminfo(filename.c_str(), &stream_info) || !FLAC__metadata_get_cuesheet(filename.c_str(), &metadata)) {
+		return std::nullopt;
+	}
+	const std::unique_ptr<FLAC__StreamMetadata, MetadataDeleter> owner(metadata);
+	const FLAC__StreamMetadata_CueSheet& cue_sheet = metadata->data.cue_sheet;
+
+	CueSheet sheet{
+		.image_filename = filename,
+		.start_rate = stream_info.data.stream_info.sample_rate,
+	};
+	// The last track is the lead-out.
+	for (unsigned i = 0; i + 1 < cue_sheet.num_tracks; ++i) {
+		const FLAC__StreamMetadata_CueSheet_Track& track = cue_sheet.tracks[i];
+		const FLAC__StreamMetadata_CueSheet_Index* const indices = track.indices;
+		const FLAC__StreamMetadata_CueSheet_Index* const end = indices + track.num_indices;
+		const FLAC__StreamMetadata_CueSheet_Index* const index = std::find_if(indices, end, [](const FLAC__StreamMetadata_CueSheet_Index& index) { return index.number == 1; });
+		// Data tracks are not part of the audio.
+		if (track.type != 0 || index == end) continue;
+		sheet.tracks.push_back(CueTrack{
+			.number = track.number,
+			.start = track.offset + index->offset,
+		});
+	}
+	if (sheet.tracks.empty()) return std::nullopt;
+	return sheet;
+}
+#endif
+
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace speedr {
+
+struct CueTrack {
+	int number;
+	std::string title;
+	// Of INDEX 01, in units of CueSheet::start_rate.
+	std::uint64_t start;
+};
+
+// The tracks of a disc image, as listed by a CUE file or by the CUESHEET
+// block of a FLAC file.
+struct CueSheet {
+	std::string image_filename;
+	std::vector<CueTrack> tracks;
+	// Units of the track starts per second: 75 for the CD frames of CUE files,
+	// the sample rate for FLAC cue sheets.
+	std::uint64_t start_rate = 75;
+
+	// First frame of each track at `samplerate`, for TrackSplitter. The first
+	// track also gets whatever precedes its INDEX 01, and the pregap of each
+	// other track (from its INDEX 00) goes to the track before it.
+	std::vector<std::uint64_t> TrackStarts(int samplerate) const;
+};
+
+// Whether `filename` has the extension of CUE files.
+bool IsCueFilename(const std::string& filename);
+
+// Only supports CUE files that describe a single audio file, whose name is
+// relative to that of the CUE file. Returns nothing if `filename` cannot be
+// read, describes several files, or has no tracks or tracks without an INDEX
+// 01 or out of order.
+std::optional<CueSheet> ReadCueSheet(const std::string& filename);
+
+#ifdef SPEEDR_HAVE_FLAC
+// Returns nothing if the FLAC file `filename` has no CUESHEET block with
+// audio tracks.
+std::optional<CueSheet> ReadFlacCueSheet(const std::string& filename);
+#endif
+
+}
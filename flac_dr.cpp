@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flac_dr.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <utility>
+
+#include <FLAC/stream_decoder.h>
+
+namespace speedr {
+
+namespace {
+
+struct DecoderDeleter {
+	void operator()(FLAC__StreamDecoder* decoder) const {
+		FLAC__stream_decoder_delete(decoder);
+	}
+};
+
+struct Decoding {
+	std::optional<IntegerDrAccumulator> accumulator;
+	int bits_per_sample = 0;
+	// Up to which samples have been pushed.
+	std::uint64_t position;
+	std::uint64_t end;
+	// When decoding a disc image, its tracks before the current one.
+	std::optional<TrackSplitter> splitter;
+	std::vector<BlockStatistics> tracks;
+	Meters* meters = nullptr;
+	// For warnings.
+	const char* filename = nullptr;
+	bool failed = false;
+};
+
+// Pushes `frames` frames of planar samples, to the current track if decoding a
+// disc image.
+void Push(Decoding& decoding, const FLAC__int32* const channels[], const unsigned num_channels, const std::size_t frames) {
+	if (!decoding.splitter) {
+		decoding.accumulator->PushPlanar(channels, frames);
+		if (decoding.meters) {
+			decoding.meters->PushPlanar(channels, frames, decoding.bits_per_sample);
+		}
+		return;
+	}
+	decoding.splitter->Split(frames, [&](const std::size_t offset, const std::size_t n) {
+		const FLAC__int32* track_channels[FLAC__MAX_CHANNELS];
+		for (unsigned c = 0; c < num_channels; ++c) {
+			track_channels[c] = &channels[c][offset];
+		}
+		decoding.accumulator->PushPlanar(track_channels, n);
+	}, [&] {
+		decoding.tracks.push_back(decoding.accumulator->FinishBlocks());
+	});
+}
+
+FLAC__StreamDecoderWriteStatus OnWrite(const FLAC__StreamDecoder*, const FLAC__Frame* frame, const FLAC__int32* const buffer[], void* client_data) {
+	Decoding& decoding = *static_cast<Decoding*>(client_data);
+	if (!decoding.accumulator) {
+		decoding.failed = true;
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	// libFLAC drops the frames whose header it cannot find again after a lost
+	// sync, so frames are placed where their header says rather than after the
+	// previous one. A gap is filled with silence, as libFLAC does itself for a
+	// frame with a bad CRC, so that the blocks after it keep their boundaries.
+	const std::uint64_t first = frame->header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER ? frame->header.number.sample_number : decoding.position;
+	const std::uint64_t end = std::min<std::uint64_t>(first + frame->header.blocksize, decoding.end);
+	const unsigned num_channels = frame->header.channels;
+	if (first > decoding.position && decoding.position < decoding.end) {
+		std::uint64_t gap = std::min(first, decoding.end) - decoding.position;
+		const std::vector<FLAC__int32> silence(std::min<std::uint64_t>(gap, frame->header.blocksize));
+		const FLAC__int32* silent_channels[FLAC__MAX_CHANNELS];
+		std::fill_n(silent_channels, num_channels, silence.data());
+		while (gap > 0) {
+			const std::size_t n = std::min<std::uint64_t>(gap, silence.size());
+			Push(decoding, silent_channels, num_channels, n);
+			gap -= n;
+		}
+		decoding.position = std::min(first, decoding.end);
+	}
+	// Samples before the position, e.g. of a frame that the seek started in,
+	// were already pushed or belong to the previous range.
+	if (end > decoding.position) {
+		const FLAC__int32* channels[FLAC__MAX_CHANNELS];
+		for (unsigned c = 0; c < num_channels; ++c) {
+			channels[c] = &buffer[c][decoding.position - first];
+		}
+		Push(decoding, channels, num_channels, end - decoding.position);
+		decoding.position = end;
+	}
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void OnMetadata(const FLAC__StreamDecoder*, const FLAC__StreamMetadata* metadata, void* client_data) {
+	Decoding& decoding = *static_cast<Decoding*>(client_data);
+	if (metadata->type != FLAC__METADATA_TYPE_STREAMINFO) return;
+	const FLAC__StreamMetadata_StreamInfo& info = metadata->data.stream_info;
+	// The squares of wider samples would not fit the integer kernels.
+	if (info.bits_per_sample > 24) {
+		decoding.failed = true;
+		return;
+	}
+	decoding.accumulator.emplace(info.sample_rate, info.channels, info.bits_per_sample);
+	decoding.bits_per_sample = info.bits_per_sample;
+}
+
+void OnError(const FLAC__StreamDecoder*, const FLAC__StreamDecoderErrorStatus status, void* client_data) {
+	Decoding& decoding = *static_cast<Decoding*>(client_data);
+	// libFLAC resynchronises on the next frame after the other errors, such as
+	// a lost sync or a CRC mismatch in a damaged file.
+	if (status == FLAC__STREAM_DECODER_ERROR_STATUS_UNPARSEABLE_STREAM) {
+		decoding.failed = true;
+		return;
+	}
+	#pragma omp critical
+	std::cerr << "Warning: " << decoding.filename << ": " << FLAC__StreamDecoderErrorStatusString[status] << ", decoding goes on" << std::endl;
+}
+
+// Decodes from `first_frame` up to `decoding.end` or the end of the stream.
+bool Decode(const std::string& filename, const std::uint64_t first_frame, Decoding& decoding) {
+	const std::unique_ptr<FLAC__StreamDecoder, DecoderDeleter> decoder(FLAC__stream_decoder_new());
+	if (!decoder) return false;
+	FLAC__stream_decoder_set_md5_checking(decoder.get(), false);
+	decoding.filename = filename.c_str();
+
+	if (FLAC__stream_decoder_init_file(decoder.get(), filename.c_str(), OnWrite, OnMetadata, OnError, &decoding) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+		return false;
+	}
+	if (!FLAC__stream_decoder_process_until_end_of_metadata(decoder.get()) || decoding.failed || !decoding.accumulator) {
+		return false;
+	}
+	// The frame containing `first_frame` is output, from that frame on, as part
+	// of the seek.
+	if (first_frame > 0 && !FLAC__stream_decoder_seek_absolute(decoder.get(), first_frame)) {
+		return false;
+	}
+	while (decoding.position < decoding.end && FLAC__stream_decoder_get_state(decoder.get()) != FLAC__STREAM_DECODER_END_OF_STREAM) {
+		if (!FLAC__stream_decoder_process_single(decoder.get()) || decoding.failed) {
+			return false;
+		}
+	}
+	FLAC__stream_decoder_finish(decoder.get());
+	return true;
+}
+
+}
+
+std::optional<BlockStatistics> ComputeFlacBlockStatistics(const std::string& filename, const std::uint64_t first_frame, const std::uint64_t end_frame, Meters* const meters) {
+	Decoding decoding{
+		.position = first_frame,
+		.end = end_frame,
+		.meters = meters,
+	};
+	if (!Decode(filename, first_frame, decoding)) {
+		return std::nullopt;
+	}
+	return decoding.accumulator->FinishBlocks();
+}
+
+std::optional<std::vector<BlockStatistics>> ComputeFlacTrackBlockStatistics(const std::string& filename, const std::vector<std::uint64_t>& track_starts) {
+	Decoding decoding{
+		.position = 0,
+		.end = std::numeric_limits<std::uint64_t>::max(),
+		.splitter = TrackSplitter(track_starts),
+	};
+	if (!Decode(filename, 0, decoding)) {
+		return std::nullopt;
+	}
+	// Including tracks that would start past the end.
+	while (decoding.tracks.size() < track_starts.size()) {
+		decoding.tracks.push_back(decoding.accumulator->FinishBlocks());
+	}
+	return std::move(decoding.tracks);
+}
+
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "compute_dr.h"
+#include "meters.h"
+
+namespace speedr {
+
+// Decodes frames `first_frame` to `end_frame` (excluded) of a FLAC file with
+// libFLAC and accumulates their planar integer samples as they come out of the
+// decoder, without the interleaving and conversion to float done by libsndfile.
+// `first_frame` is reached by seeking, which libFLAC does with the seektable if
+// there is one and by looking for frame headers otherwise, so several ranges of
+// the same file can be decoded concurrently. Errors that libFLAC recovers from,
+// such as a lost sync, are reported on stderr and decoding goes on, with
+// silence in place of the frames that libFLAC drops. Returns nothing if libFLAC
+// cannot seek to `first_frame` or decode the range, or the samples have more
+// than 24 bits, in which case libsndfile should be used instead, after
+// restarting `meters`, which are also fed the samples if given.
+std::optional<BlockStatistics> ComputeFlacBlockStatistics(const std::string& filename, std::uint64_t first_frame = 0, std::uint64_t end_frame = std::numeric_limits<std::uint64_t>::max(), Meters* meters = nullptr);
+// Decodes a whole FLAC file once, as consecutive tracks that start at
+// `track_starts` (see TrackSplitter).
+std::optional<std::vector<BlockStatistics>> ComputeFlacTrackBlockStatistics(const std::string& filename, const std::vector<std::uint64_t>& track_starts);
+
+}
@@ -0,0 +1,283 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "loudness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "loudness.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/aligned_allocator.h>
+#include <hwy/highway.h>
+
+namespace speedr {
+
+namespace HWY_NAMESPACE {
+namespace {
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+#if HWY_HAVE_FLOAT64
+
+std::size_t NumDoubleLanes() {
+	return hn::Lanes(hn::ScalableTag<double>());
+}
+
+// Runs the K-weighting filter over `frames` frames of `num_channels`
+// interleaved samples, with one channel per lane, and adds the squares of its
+// output to `sums_of_squares`. The filter is recursive, so the channels, not
+// the samples, are what is processed in parallel.
+HWY_ATTR void AccumulateKWeighted(const float* HWY_RESTRICT interleaved, const std::size_t frames, const int num_channels, const double* HWY_RESTRICT filter, double* HWY_RESTRICT state, double* HWY_RESTRICT sums_of_squares) {
+	const hn::ScalableTag<double> d;
+	const std::size_t num_lanes = hn::Lanes(d);
+	const auto shelf_b0 = hn::Set(d, filter[0]);
+	const auto shelf_b1 = hn::Set(d, filter[1]);
+	const auto shelf_b2 = hn::Set(d, filter[2]);
+	const auto shelf_a1 = hn::Set(d, filter[3]);
+	const auto shelf_a2 = hn::Set(d, filter[4]);
+	const auto high_pass_a1 = hn::Set(d, filter[5]);
+	const auto high_pass_a2 = hn::Set(d, filter[6]);
+	const auto minus_two = hn::Set(d, -2.);
+
+	// Lanes beyond the last channel stay at zero.
+	HWY_ALIGN double lanes[HWY_MAX_BYTES / sizeof(double)] = {};
+	for (std::size_t first = 0; first < static_cast<std::size_t>(num_channels); first += num_lanes) {
+		const std::size_t n = std::min<std::size_t>(num_lanes, num_channels - first);
+		double* const group_state = &state[4 * first];
+		auto shelf_s1 = hn::Load(d, &group_state[0]);
+		auto shelf_s2 = hn::Load(d, &group_state[num_lanes]);
+		auto high_pass_s1 = hn::Load(d, &group_state[2 * num_lanes]);
+		auto high_pass_s2 = hn::Load(d, &group_state[3 * num_lanes]);
+		auto sum = hn::Load(d, &sums_of_squares[first]);
+
+		const float* sample = &interleaved[first];
+		for (std::size_t frame = 0; frame < frames; ++frame, sample += num_channels) {
+			for (std::size_t i = 0; i < n; ++i) {
+				lanes[i] = sample[i];
+			}
+			const auto x = hn::Load(d, lanes);
+			// Both biquads in transposed direct form II.
+			const auto shelved = hn::MulAdd(shelf_b0, x, shelf_s1);
+			shelf_s1 = hn::MulAdd(shelf_b1, x, hn::NegMulAdd(shelf_a1, shelved, shelf_s2));
+			shelf_s2 = hn::NegMulAdd(shelf_a2, shelved, hn::Mul(shelf_b2, x));
+			const auto weighted = hn::Add(shelved, high_pass_s1);
+			high_pass_s1 = hn::NegMulAdd(high_pass_a1, weighted, hn::MulAdd(minus_two, shelved, high_pass_s2));
+			high_pass_s2 = hn::NegMulAdd(high_pass_a2, weighted, shelved);
+			sum = hn::MulAdd(weighted, weighted, sum);
+		}
+
+		hn::Store(shelf_s1, d, &group_state[0]);
+		hn::Store(shelf_s2, d, &group_state[num_lanes]);
+		hn::Store(high_pass_s1, d, &group_state[2 * num_lanes]);
+		hn::Store(high_pass_s2, d, &group_state[3 * num_lanes]);
+		hn::Store(sum, d, &sums_of_squares[first]);
+	}
+}
+
+#else
+
+// Targets without double lanes, such as Armv7 NEON, filter one channel at a
+// time, with the same arithmetic as the lanes of the other targets.
+std::size_t NumDoubleLanes() {
+	return 1;
+}
+
+void AccumulateKWeighted(const float* HWY_RESTRICT interleaved, const std::size_t frames, const int num_channels, const double* HWY_RESTRICT filter, double* HWY_RESTRICT state, double* HWY_RESTRICT sums_of_squares) {
+	for (int c = 0; c < num_channels; ++c) {
+		double* const channel_state = &state[4 * c];
+		double shelf_s1 = channel_state[0];
+		double shelf_s2 = channel_state[1];
+		double high_pass_s1 = channel_state[2];
+		double high_pass_s2 = channel_state[3];
+		double sum = sums_of_squares[c];
+		for (std::size_t frame = 0; frame < frames; ++frame) {
+			const double x = interleaved[frame * num_channels + c];
+			const double shelved = std::fma(filter[0], x, shelf_s1);
+			shelf_s1 = std::fma(filter[1], x, std::fma(-filter[3], shelved, shelf_s2));
+			shelf_s2 = std::fma(-filter[4], shelved, filter[2] * x);
+			const double weighted = shelved + high_pass_s1;
+			high_pass_s1 = std::fma(-filter[5], weighted, std::fma(-2., shelved, high_pass_s2));
+			high_pass_s2 = std::fma(-filter[6], weighted, shelved);
+			sum = std::fma(weighted, weighted, sum);
+		}
+		channel_state[0] = shelf_s1;
+		channel_state[1] = shelf_s2;
+		channel_state[2] = high_pass_s1;
+		channel_state[3] = high_pass_s2;
+		sums_of_squares[c] = sum;
+	}
+}
+
+#endif
+}
+}
+
+#if HWY_ONCE
+
+namespace {
+HWY_EXPORT(NumDoubleLanes);
+HWY_EXPORT(AccumulateKWeighted);
+
+constexpr double kAbsoluteGate = -70;
+// Relative gates, in LU below the mean of what passes the absolute gate.
+constexpr double kIntegratedRelativeGate = -10;
+constexpr double kRangeRelativeGate = -20;
+// In steps of 100 ms.
+constexpr std::size_t kMomentarySteps = 4;
+constexpr std::size_t kShortTermSteps = 30;
+
+double ToLoudness(const double power) {
+	return -0.691 + 10 * std::log10(power);
+}
+
+double ToPower(const double loudness) {
+	return std::pow(10., (loudness + 0.691) / 10);
+}
+
+// Mean power of each window of `window_steps` consecutive steps, one step
+// apart.
+std::vector<double> GetWindowPowers(const std::vector<double>& steps, const std::size_t window_steps) {
+	std::vector<double> powers;
+	for (std::size_t first = 0; first + window_steps <= steps.size(); ++first) {
+		powers.push_back(std::accumulate(&steps[first], &steps[first + window_steps], 0.) / window_steps);
+	}
+	return powers;
+}
+
+// Mean of the powers above `gate`, or 0 if there are none.
+double GetMeanAbove(const std::vector<double>& powers, const double gate) {
+	double sum = 0;
+	std::size_t count = 0;
+	for (const double power: powers) {
+		if (power > gate) {
+			sum += power;
+			++count;
+		}
+	}
+	return count == 0 ? 0 : sum / count;
+}
+
+double GetMaxLoudness(const std::vector<double>& powers) {
+	if (powers.empty()) return -std::numeric_limits<double>::infinity();
+	return ToLoudness(*std::max_element(powers.begin(), powers.end()));
+}
+
+}
+
+LoudnessMeter::LoudnessMeter(const int samplerate, const int num_channels)
+	: num_channels_(num_channels),
+	  num_lanes_(HWY_DYNAMIC_DISPATCH(NumDoubleLanes)()),
+	  num_padded_channels_((num_channels + num_lanes_ - 1) / num_lanes_ * num_lanes_),
+	  weights_(num_channels, 1.),
+	  state_(hwy::AllocateAligned<double>(4 * num_padded_channels_)),
+	  sums_of_squares_(hwy::AllocateAligned<double>(num_padded_channels_)),
+	  step_size_(std::max(1L, std::lround(samplerate / 10.))) {
+	// The coefficients of BS.1770 are given for 48 kHz; these are those of the
+	// analogue prototypes that they come from, as derived for libebur128.
+	const double pi = std::acos(-1.);
+	{
+		const double f0 = 1681.974450955533;
+		const double gain = 3.999843853973347;
+		const double q = 0.7071752369554196;
+		const double k = std::tan(pi * f0 / samplerate);
+		const double vh = std::pow(10., gain / 20);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		const double a0 = 1 + k / q + k * k;
+		filter_[0] = (vh + vb * k / q + k * k) / a0;
+		filter_[1] = 2 * (k * k - vh) / a0;
+		filter_[2] = (vh - vb * k / q + k * k) / a0;
+		filter_[3] = 2 * (k * k - 1) / a0;
+		filter_[4] = (1 - k / q + k * k) / a0;
+	}
+	{
+		const double f0 = 38.13547087602444;
+		const double q = 0.5003270373238773;
+		const double k = std::tan(pi * f0 / samplerate);
+		const double a0 = 1 + k / q + k * k;
+		filter_[5] = 2 * (k * k - 1) / a0;
+		filter_[6] = (1 - k / q + k * k) / a0;
+	}
+
+	if (num_channels == 5) {
+		weights_[3] = weights_[4] = 1.41;
+	}
+	else if (num_channels == 6) {
+		weights_[3] = 0;
+		weights_[4] = weights_[5] = 1.41;
+	}
+	std::fill_n(state_.get(), 4 * num_padded_channels_, 0.);
+	std::fill_n(sums_of_squares_.get(), num_padded_channels_, 0.);
+}
+
+void LoudnessMeter::Push(const float* interleaved, const std::size_t frames) {
+	std::size_t offset = 0;
+	while (offset < frames) {
+		const std::size_t n = std::min(frames - offset, step_size_ - frames_in_step_);
+		HWY_DYNAMIC_DISPATCH(AccumulateKWeighted)(&interleaved[offset * num_channels_], n, num_channels_, filter_.data(), state_.get(), sums_of_squares_.get());
+		frames_in_step_ += n;
+		offset += n;
+		if (frames_in_step_ == step_size_) {
+			EndStep();
+		}
+	}
+}
+
+Loudness LoudnessMeter::Finish() const {
+	const double absolute_gate = ToPower(kAbsoluteGate);
+
+	const std::vector<double> momentary = GetWindowPowers(steps_, kMomentarySteps);
+	const double integrated_gate = std::max(absolute_gate, GetMeanAbove(momentary, absolute_gate) * std::pow(10., kIntegratedRelativeGate / 10));
+
+	const std::vector<double> short_term = GetWindowPowers(steps_, kShortTermSteps);
+	const double range_gate = std::max(absolute_gate, GetMeanAbove(short_term, absolute_gate) * std::pow(10., kRangeRelativeGate / 10));
+	std::vector<double> gated_short_term;
+	for (const double power: short_term) {
+		if (power > range_gate) {
+			gated_short_term.push_back(ToLoudness(power));
+		}
+	}
+	double range = 0;
+	if (!gated_short_term.empty()) {
+		// From the 10th to the 95th percentile, by nearest rank.
+		std::sort(gated_short_term.begin(), gated_short_term.end());
+		const std::size_t last = gated_short_term.size() - 1;
+		range = gated_short_term[std::lround(0.95 * last)] - gated_short_term[std::lround(0.1 * last)];
+	}
+
+	return {
+		.integrated = ToLoudness(GetMeanAbove(momentary, integrated_gate)),
+		.range = range,
+		.max_momentary = GetMaxLoudness(momentary),
+		.max_short_term = GetMaxLoudness(short_term),
+	};
+}
+
+void LoudnessMeter::EndStep() {
+	double power = 0;
+	for (int c = 0; c < num_channels_; ++c) {
+		power += weights_[c] * sums_of_squares_[c];
+	}
+	steps_.push_back(power / step_size_);
+	std::fill_n(sums_of_squares_.get(), num_padded_channels_, 0.);
+	frames_in_step_ = 0;
+}
+
+#endif
+}
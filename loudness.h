@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include <hwy/aligned_allocator.h>
+
+namespace speedr {
+
+// The EBU R128 measures of a track. Loudness that cannot be measured, for
+// lack of audio above the absolute gate, is -infinity.
+struct Loudness {
+	// In LUFS, with the two gates of ITU-R BS.1770-4.
+	double integrated;
+	// In LU, as defined by EBU Tech 3342.
+	double range;
+	// Highest loudness over 400 ms (momentary) and 3 s (short-term), in LUFS.
+	double max_momentary;
+	double max_short_term;
+};
+
+// Measures the loudness of interleaved samples pushed in chunks of any size.
+// Channels are weighted as in BS.1770, with 5 channels taken to be L, R, C,
+// Ls and Rs, and 6 channels L, R, C, LFE, Ls and Rs (the order of WAV files),
+// whose LFE is left out.
+class LoudnessMeter {
+public:
+	LoudnessMeter(int samplerate, int num_channels);
+
+	void Push(const float* interleaved, std::size_t frames);
+	// From the samples pushed so far. A partial last step of 100 ms is left
+	// out.
+	Loudness Finish() const;
+
+private:
+	void EndStep();
+
+	int num_channels_;
+	// Of double lanes; the channels are filtered that many at a time.
+	std::size_t num_lanes_;
+	std::size_t num_padded_channels_;
+	// Of the high shelf (b0, b1, b2, a1, a2) then of the high pass (a1, a2),
+	// whose numerator is always (1, -2, 1).
+	std::array<double, 7> filter_;
+	std::vector<double> weights_;
+	// The four state variables of the two biquads of each channel, and the
+	// sum of the squares of the filtered samples of the current step.
+	hwy::AlignedFreeUniquePtr<double[]> state_;
+	hwy::AlignedFreeUniquePtr<double[]> sums_of_squares_;
+	std::size_t step_size_;
+	std::size_t frames_in_step_ = 0;
+	// Weighted sum of the mean squares of the channels, for each 100 ms step.
+	// Gating blocks and short-term windows are made of consecutive steps.
+	std::vector<double> steps_;
+};
+
+}
@@ -13,9 +13,19 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <ctime>
 #include <iostream>
-#include <tuple>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -26,36 +36,417 @@
 #include <omp.h>
 #endif
 
+#include "bit_depth.h"
+#include "cache.h"
+#include "clipping.h"
 #include "compute_dr.h"
+#include "cue_sheet.h"
+#include "meters.h"
+#include "ndjson.h"
+#include "raw_pcm.h"
+#include "sidecar.h"
+#include "sliding_dr.h"
 
+using ::speedr::BlockStatistics;
+using ::speedr::CachedResult;
+using ::speedr::CueSheet;
+using ::speedr::Measurements;
+using ::speedr::MeterOptions;
+using ::speedr::Meters;
+using ::speedr::NdjsonWriter;
+using ::speedr::PcmStream;
+using ::speedr::PipelineStalls;
 using ::speedr::Rating;
+using ::speedr::RawPcmFormat;
+using ::speedr::ResultCache;
+using ::speedr::ResultSource;
+using ::speedr::Sidecar;
+using ::speedr::SlidingDrMeter;
+using ::speedr::TrackReport;
+
+namespace {
+// Stands for raw samples read from standard input.
+constexpr char kStandardInput[] = "-";
+
+SndfileHandle OpenInput(const std::string& filename) {
+#ifdef _WIN32
+	return SndfileHandle(CLI::widen(filename).c_str());
+#else
+	return SndfileHandle(filename);
+#endif
+}
+
+// Rough relative cost of analysing `input`, so that the longest tracks can be
+// started first. Uncompressed formats are read almost in place, FLAC costs a
+// lossless decode, and anything else is assumed to be a slower lossy decode.
+double EstimateCost(const SndfileHandle& input) {
+	const double samples = static_cast<double>(input.frames()) * input.channels();
+	switch (input.format() & SF_FORMAT_TYPEMASK) {
+		case SF_FORMAT_WAV:
+		case SF_FORMAT_WAVEX:
+		case SF_FORMAT_RF64:
+		case SF_FORMAT_AIFF:
+		case SF_FORMAT_CAF:
+			return samples;
+		case SF_FORMAT_FLAC:
+			return 4 * samples;
+		default:
+			return 8 * samples;
+	}
+}
+
+// What is kept of each track between probing it for its cost and analysing
+// it, so that inputs are only open while they are being analysed.
+struct Track {
+	std::string filename;
+	std::uint64_t frames = 0;
+	int samplerate = 0;
+	double cost = 0;
+	Rating rating = {};
+	// Besides the rating, when requested.
+	Measurements measurements = {};
+	PipelineStalls stalls = {};
+	// Under which to store the results once computed, if a cache is used.
+	std::string cache_key = {};
+	ResultSource source = ResultSource::kAnalysis;
+	bool failed = false;
+	// For a disc image, the first frame, name and rating of each of its
+	// tracks, which are reported instead of the image itself.
+	std::vector<std::uint64_t> track_starts = {};
+	std::vector<std::string> track_names = {};
+	std::vector<Rating> track_ratings = {};
+
+	std::uint64_t TrackFrames(const std::size_t i) const {
+		const std::uint64_t end = i + 1 < track_starts.size() ? track_starts[i + 1] : frames;
+		return std::max(end, track_starts[i]) - track_starts[i];
+	}
+};
+
+// CPU time of the calling thread, or of the whole process where that is not
+// available.
+double ThreadCpuSeconds() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	timespec time;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+	return time.tv_sec + 1e-9 * time.tv_nsec;
+#else
+	return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+// `filename` if it is already that of a sidecar, or that of the sidecar of
+// the audio file `filename`.
+std::string GetSidecarFilename(const std::string& filename) {
+	const std::string_view extension = speedr::kSidecarExtension;
+	if (filename.size() >= extension.size() && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0) {
+		return filename;
+	}
+	return filename + speedr::kSidecarExtension;
+}
+
+bool WriteSidecar(const Track& track, const BlockStatistics& statistics) {
+	const std::string filename = GetSidecarFilename(track.filename);
+	if (speedr::WriteSidecar(filename, Sidecar{statistics, track.frames, track.samplerate, speedr::GetBlockSize(track.samplerate)})) {
+		return true;
+	}
+	#pragma omp critical
+	std::cerr << "Failed to write " << filename << std::endl;
+	return false;
+}
+
+// Prints the rating of the last `window_seconds` of each input after each of
+// its blocks, as it is read. For inputs that keep growing, or have no end.
+int MeterLive(const std::vector<std::string>& filenames, const double window_seconds, std::optional<PcmStream>& standard_input, const bool pipeline, std::ostream& out) {
+	for (const std::string& filename: filenames) {
+		SndfileHandle input;
+		int samplerate, channels;
+		if (filename == kStandardInput) {
+			samplerate = standard_input->format().samplerate;
+			channels = standard_input->format().channels;
+		}
+		else {
+			input = OpenInput(filename);
+			if (!input.rawHandle()) {
+				std::cerr << "Failed to open " << filename << " for audio decoding: " << input.strError() << std::endl;
+				return EXIT_FAILURE;
+			}
+			samplerate = input.samplerate();
+			channels = input.channels();
+		}
+		const double block_seconds = static_cast<double>(speedr::GetBlockSize(samplerate)) / samplerate;
+		SlidingDrMeter meter(channels, std::lround(window_seconds / block_seconds));
+		std::uint64_t num_blocks = 0;
+		const auto on_blocks = [&](const BlockStatistics& statistics) {
+			for (std::size_t block = 0; block < statistics.mean_square[0].size(); ++block) {
+				meter.Push(statistics, block);
+				++num_blocks;
+				const Rating rating = meter.Rate();
+				out << filename << '\t' << num_blocks * block_seconds << '\t';
+				if (std::isfinite(rating.final_rating)) {
+					out << "DR" << rating.final_rating;
+				}
+				else {
+					out << "N/A";
+				}
+				for (const float channel_rating: rating.ChannelRatings()) {
+					out << '\t' << channel_rating;
+				}
+				out << std::endl;
+			}
+		};
+
+		if (filename == kStandardInput) {
+			if (!standard_input->Stream(on_blocks)) {
+				std::cerr << "Failed to read standard input" << std::endl;
+				return EXIT_FAILURE;
+			}
+			continue;
+		}
+		PipelineStalls stalls;
+		speedr::StreamBlockStatistics(input, on_blocks, pipeline ? &stalls : nullptr);
+		if (pipeline) {
+			std::cerr << "Pipeline stalls: decoding waited " << stalls.decoding << " s, analysis waited " << stalls.analysis << " s" << std::endl;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+int ThreadNum() {
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+}
 
 int main(int argc, char** argv) {
 	CLI::App app("SpeeDR - dynamic range calculator");
 	argv = app.ensure_utf8(argv);
 	std::vector<std::string> filenames;
-	app.add_option("filename", filenames, "Files to analyse")->required();
+	app.add_option("filename", filenames, std::string("Files to analyse, or ") + kStandardInput + " for WAV or raw samples from standard input")->required();
+	std::string raw_format;
+	CLI::Option* const raw_format_option = app.add_option("--raw-format", raw_format, "Format of the raw samples from standard input: s16le, s24le, s32le or f32le")->check(CLI::IsMember({"s16le", "s24le", "s32le", "f32le"}));
+	int raw_samplerate = 0;
+	CLI::Option* const raw_samplerate_option = app.add_option("--rate", raw_samplerate, "Sample rate of the raw samples from standard input")->check(CLI::PositiveNumber)->needs(raw_format_option);
+	int raw_channels = 0;
+	CLI::Option* const raw_channels_option = app.add_option("--channels", raw_channels, "Number of channels of the raw samples from standard input")->check(CLI::PositiveNumber)->needs(raw_format_option);
+	raw_format_option->needs(raw_samplerate_option)->needs(raw_channels_option);
+	bool tee = false;
+	app.add_flag("--tee", tee, std::string("Copy standard input (") + kStandardInput + ") to standard output as it is read, unchanged, to rate audio on its way from a decoder to an encoder. The results then go to stderr");
+	bool pipeline = false;
+	app.add_flag("--pipeline", pipeline, "Decode on a separate thread, ahead of the analysis, and report how long each side waited for the other");
+	bool report_idle = false;
+	app.add_flag("--report-idle", report_idle, "Report how long the threads analysing tracks were left without a track");
+	bool ndjson = false;
+	app.add_flag("--ndjson", ndjson, "Print each track's results as a JSON object on its own line as soon as it is analysed, and the album rating to stderr");
+	std::string cache_filename;
+	app.add_option("--cache", cache_filename, "File in which to keep results, so that unchanged files are not analysed again");
+	std::string cache_key = "stat";
+	app.add_option("--cache-key", cache_key, "What identifies a file in the cache: its inode and modification time (stat), or its audio (content: the MD5 of FLAC files, a hash of the samples of uncompressed files, falling back to stat for other files)")->check(CLI::IsMember({"stat", "content"}));
+	bool write_sidecars = false;
+	CLI::Option* const write_sidecars_option = app.add_flag("--write-sidecars", write_sidecars, std::string("Write the block statistics of each file next to it, with the extension ") + speedr::kSidecarExtension);
+	bool from_sidecars = false;
+	CLI::Option* const from_sidecars_option = app.add_flag("--from-sidecars", from_sidecars, "Compute the track and album ratings from the sidecars of the files (which can also be passed directly) instead of decoding them")->excludes(write_sidecars_option);
+	double window_start = 0;
+	CLI::Option* const window_start_option = app.add_option("--window-start", window_start, "Rate only the part of each track from this time in seconds, rounded down to a block, with the index kept in its sidecar")->check(CLI::NonNegativeNumber)->needs(from_sidecars_option);
+	double window_end = 0;
+	CLI::Option* const window_end_option = app.add_option("--window-end", window_end, "Rate only the part of each track up to this time in seconds, rounded up to a block, with the index kept in its sidecar")->check(CLI::PositiveNumber)->needs(from_sidecars_option);
+#ifdef SPEEDR_HAVE_FLAC
+	bool embedded_cue = false;
+	app.add_flag("--embedded-cue", embedded_cue, "Rate each track of FLAC files that carry a cue sheet, rather than the whole file");
+#endif
+	MeterOptions meter_options;
+	app.add_flag("--loudness", meter_options.loudness, "Also measure the EBU R128 loudness of each track (integrated loudness, loudness range, and highest momentary and short-term loudness) in the same pass. Not for disc images, and not kept in the cache, whose results are then recomputed")->excludes(from_sidecars_option);
+	app.add_flag("--true-peak", meter_options.true_peak, "Also measure the true peak of each track in dBTP, oversampled 4 times as in BS.1770, in the same pass. Same restrictions as --loudness")->excludes(from_sidecars_option);
+	app.add_flag("--stereo", meter_options.stereo, "Also measure the phase correlation of the channels of each stereo track and the energy of its side relative to its mid, overall and per block, to spot masters that cancel out in mono or that are mono in disguise, in the same pass. Same restrictions as --loudness")->excludes(from_sidecars_option);
+	bool bit_depth = false;
+	app.add_flag("--bit-depth", bit_depth, "Also report the effective bit depth of each track of up to 24 bits read as integers, down to the lowest bit set in any of its samples (which exposes e.g. 16-bit audio padded to 24 bits), and the DC offset of each of its channels, which are found in the same pass and kept in the cache. Not for disc images")->excludes(from_sidecars_option);
+	double live_window = 0;
+	app.add_option("--live-window", live_window, "Instead of rating whole tracks, print the rating of this many seconds before the end of each block, as the inputs are read (tab-separated: file, end of the block in seconds, rating and channel ratings). Only --pipeline applies")->check(CLI::PositiveNumber)->excludes(from_sidecars_option)->excludes(write_sidecars_option);
+	int max_open_files = 0;
+	app.add_option("--max-open-files", max_open_files, "Limit the number of files open at once, libFLAC decoders included, at the expense of parallelism (0 for no limit besides the number of threads)")->check(CLI::NonNegativeNumber);
 	CLI11_PARSE(app, argc, argv);
+	const bool windowed = *window_start_option || *window_end_option;
+	std::optional<RawPcmFormat> raw_pcm;
+	if (!raw_format.empty()) {
+		raw_pcm = RawPcmFormat{*speedr::GetRawPcmLayout(raw_format), raw_samplerate, raw_channels};
+	}
+	const auto num_standard_inputs = std::count(filenames.begin(), filenames.end(), kStandardInput);
+	if (num_standard_inputs > 1 || (tee && num_standard_inputs == 0)) {
+		std::cerr << "Standard input can only be read once, and --tee needs it" << std::endl;
+		return EXIT_FAILURE;
+	}
+	// Its header, if any, is read upfront like those of the other inputs.
+	std::optional<PcmStream> standard_input;
+	if (num_standard_inputs > 0) {
+		standard_input = PcmStream::Open(0, raw_pcm, tee ? 1 : -1);
+		if (!standard_input) {
+			std::cerr << "Failed to read standard input as WAV; raw samples need --raw-format, --rate and --channels" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	// Standard output carries the audio in tee mode.
+	std::ostream& out = tee ? std::cerr : std::cout;
+	// Gives up on the inputs, but in tee mode only once the rest of standard
+	// input has been copied, so that the next stage of the pipe gets all of it.
+	const auto fail = [&] {
+		if (standard_input) {
+			standard_input->Drain();
+		}
+		return EXIT_FAILURE;
+	};
+	if (live_window > 0) {
+		return MeterLive(filenames, live_window, standard_input, pipeline, out) == EXIT_SUCCESS ? EXIT_SUCCESS : fail();
+	}
 
-	std::vector<std::tuple<std::string_view, SndfileHandle, Rating>> tracks;
+	std::unique_ptr<ResultCache> cache;
+	if (!cache_filename.empty() && !from_sidecars) {
+		cache = ResultCache::Open(cache_filename);
+		if (!cache) {
+			std::cerr << "Warning: cannot use " << cache_filename << " as a cache, results will not be cached." << std::endl;
+		}
+	}
+
+	std::vector<Track> tracks;
+	tracks.reserve(filenames.size());
+	std::vector<std::size_t> order;
 
 	bool print_multichannel_warning = false;
+	// Adds to the measurements of `track` those found in its block statistics.
+	const auto measure_blocks = [&](Track& track, const BlockStatistics& statistics) {
+		track.measurements.clipping = speedr::FindClipping(statistics);
+		if (bit_depth) {
+			track.measurements.bit_depth = speedr::FindBitDepth(statistics, track.frames);
+		}
+	};
 
-	for (const std::string& filename: filenames) {
-#ifdef _WIN32
-		SndfileHandle input(CLI::widen(filename).c_str());
-#else
-		SndfileHandle input(filename);
+	// Content keys can take reading whole files, so they are computed in
+	// parallel beforehand, by threads that each hold one input open at a time.
+	std::vector<std::optional<std::string>> cache_keys(filenames.size());
+	if (cache) {
+#ifdef _OPENMP
+		const int key_threads = max_open_files > 0 ? std::min(max_open_files, omp_get_max_threads()) : omp_get_max_threads();
+#endif
+		#pragma omp parallel for num_threads(key_threads) schedule(dynamic, 1)
+		for (std::size_t i = 0; i < filenames.size(); ++i) {
+			if (cache_key == "content") {
+				cache_keys[i] = speedr::GetContentKey(filenames[i]);
+			}
+			if (!cache_keys[i]) {
+				cache_keys[i] = speedr::GetFileKey(filenames[i]);
+			}
+		}
+	}
+
+	// Only the header of each input is read here, and the input closed again
+	// until its analysis. Inputs found in the cache are not opened at all.
+	for (std::size_t i = 0; i < filenames.size(); ++i) {
+		const std::string& filename = filenames[i];
+		Track& track = tracks.emplace_back(Track{filename});
+		std::optional<CueSheet> cue_sheet;
+		if (speedr::IsCueFilename(filename)) {
+			cue_sheet = speedr::ReadCueSheet(filename);
+			if (!cue_sheet) {
+				std::cerr << "Failed to read " << filename << " as the cue sheet of a single audio file" << std::endl;
+				return fail();
+			}
+		}
+#ifdef SPEEDR_HAVE_FLAC
+		else if (embedded_cue && !from_sidecars) {
+			cue_sheet = speedr::ReadFlacCueSheet(filename);
+		}
 #endif
+		if (from_sidecars) {
+			const std::string sidecar_filename = GetSidecarFilename(filename);
+			std::optional<Sidecar> sidecar = speedr::ReadSidecar(sidecar_filename);
+			if (!sidecar) {
+				std::cerr << "Failed to read " << sidecar_filename << " as a sidecar" << std::endl;
+				return fail();
+			}
+			track.frames = sidecar->frames;
+			track.samplerate = sidecar->samplerate;
+			if (windowed) {
+				// The blocks that overlap the window.
+				const double block_seconds = static_cast<double>(sidecar->block_size) / sidecar->samplerate;
+				const std::size_t num_blocks = sidecar->index.num_blocks();
+				const auto first_block = static_cast<std::size_t>(std::min<double>(std::floor(window_start / block_seconds), num_blocks));
+				const std::size_t end_block = *window_end_option ? static_cast<std::size_t>(std::min<double>(std::ceil(window_end / block_seconds), num_blocks)) : num_blocks;
+				if (first_block >= end_block) {
+					std::cerr << "The window holds no block of " << sidecar_filename << std::endl;
+					return fail();
+				}
+				track.rating = sidecar->index.Rate(first_block, end_block);
+			}
+			else {
+				track.rating = Rating::FromBlockStatistics(std::move(sidecar->statistics));
+			}
+			track.source = ResultSource::kSidecar;
+			if (track.rating.ChannelRatings().size() > 2) {
+				print_multichannel_warning = true;
+			}
+			continue;
+		}
+		if (filename == kStandardInput) {
+			track.samplerate = standard_input->format().samplerate;
+			// Its length is unknown, so it is started first.
+			track.cost = std::numeric_limits<double>::infinity();
+			if (standard_input->format().channels > 2) {
+				print_multichannel_warning = true;
+			}
+			order.push_back(tracks.size() - 1);
+			continue;
+		}
+		// Disc images are rated track by track, which is neither cached nor kept
+		// in sidecars.
+		std::optional<std::string>& key = cache_keys[i];
+		if (key && !cue_sheet) {
+			std::optional<CachedResult> result = cache->Find(*key);
+			// Measurements are not cached, so tracks to measure are analysed
+			// again, but only stored if they were not found.
+			if (result && !meter_options.any()) {
+				track.frames = result->frames;
+				track.samplerate = result->samplerate;
+				track.rating = std::move(result->rating);
+				track.source = ResultSource::kCache;
+				measure_blocks(track, result->statistics);
+				if (write_sidecars && !WriteSidecar(track, result->statistics)) {
+					return fail();
+				}
+				if (track.rating.ChannelRatings().size() > 2) {
+					print_multichannel_warning = true;
+				}
+				continue;
+			}
+			if (!result) {
+				track.cache_key = std::move(*key);
+			}
+		}
+
+		if (cue_sheet) {
+			track.filename = cue_sheet->image_filename;
+		}
+		SndfileHandle input = OpenInput(track.filename);
 		if (!input.rawHandle()) {
-			std::cerr << "Failed to open " << filename << " for audio decoding: " << input.strError() << std::endl;
-			return EXIT_FAILURE;
+			std::cerr << "Failed to open " << track.filename << " for audio decoding: " << input.strError() << std::endl;
+			return fail();
 		}
 		if (input.channels() > 2) {
 			print_multichannel_warning = true;
 		}
 
-		tracks.emplace_back(filename, std::move(input), Rating());
+		track.frames = input.frames();
+		track.samplerate = input.samplerate();
+		track.cost = EstimateCost(input);
+		if (cue_sheet) {
+			track.track_starts = cue_sheet->TrackStarts(track.samplerate);
+			for (const speedr::CueTrack& cue_track: cue_sheet->tracks) {
+				char number[16];
+				std::snprintf(number, sizeof number, " #%02d", cue_track.number);
+				track.track_names.push_back(filename + number + (cue_track.title.empty() ? "" : " " + cue_track.title));
+			}
+		}
+		order.push_back(tracks.size() - 1);
 	}
 
 	if (print_multichannel_warning) {
@@ -63,49 +454,217 @@ int main(int argc, char** argv) {
 	}
 
 #ifdef _OPENMP
-	const int num_threads = std::min<int>(tracks.size(), omp_get_max_threads());
+	const std::size_t num_analysed = std::max<std::size_t>(1, order.size());
+	int num_threads = std::min<int>(num_analysed, omp_get_max_threads());
+	// Threads that are not needed for one track each are shared among the
+	// tracks, which can then split their own analysis.
+	int threads_per_track = std::max<int>(1, omp_get_max_threads() / num_analysed);
+	if (max_open_files > 0) {
+		// A track being analysed holds its input open throughout, and each
+		// range it is split into opens one more file: a libsndfile handle of
+		// its own or, for FLAC, the libFLAC decoder that replaces it. The
+		// input's handle stays open beside those decoders, so a FLAC track
+		// split into n ranges holds n + 1 files, as any other track at most.
+		num_threads = std::min(num_threads, std::max(1, max_open_files / 2));
+		threads_per_track = std::min(threads_per_track, std::max(1, max_open_files / num_threads - 1));
+	}
+	omp_set_max_active_levels(2);
+#else
+	const int num_threads = 1;
+	const int threads_per_track = 1;
 #endif
 
-	#pragma omp parallel for num_threads(num_threads)
-	for (auto& track: tracks) {
-		std::get<Rating>(track) = Rating::Compute(std::get<SndfileHandle>(track));
+	// Tracks are handed out one at a time, longest first, so that a long track
+	// drawn last does not keep one thread busy long after the others are done.
+	std::stable_sort(order.begin(), order.end(), [&tracks](const std::size_t a, const std::size_t b) { return tracks[a].cost > tracks[b].cost; });
+
+	std::vector<double> busy_seconds(num_threads);
+	std::vector<NdjsonWriter> writers(num_threads, NdjsonWriter(tee ? stderr : stdout));
+	if (ndjson) {
+		for (const Track& track: tracks) {
+			if (track.source != ResultSource::kAnalysis) {
+				writers[0].Write(TrackReport{track.filename, track.rating, track.frames, track.samplerate, 0., 0., track.source, &track.measurements});
+			}
+		}
 	}
+	const auto start = std::chrono::steady_clock::now();
+	#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1)
+	for (std::size_t i = 0; i < order.size(); ++i) {
+		const auto track_start = std::chrono::steady_clock::now();
+		const double track_cpu_start = ThreadCpuSeconds();
+		Track& track = tracks[order[i]];
+		const std::string& filename = track.filename;
+		SndfileHandle input = filename == kStandardInput ? SndfileHandle() : OpenInput(filename);
+		std::optional<Meters> meters;
+		if (filename == kStandardInput) {
+			if (meter_options.any()) {
+				meters.emplace(track.samplerate, standard_input->format().channels, meter_options);
+			}
+			if (std::optional<BlockStatistics> statistics = standard_input->ComputeBlockStatistics(&track.frames, meters ? &*meters : nullptr)) {
+				if (meters) {
+					track.measurements = meters->Finish();
+				}
+				measure_blocks(track, *statistics);
+				track.rating = Rating::FromBlockStatistics(std::move(*statistics));
+				if (ndjson) {
+					const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - track_start).count();
+					writers[ThreadNum()].Write(TrackReport{filename, track.rating, track.frames, track.samplerate, wall_seconds, ThreadCpuSeconds() - track_cpu_start, ResultSource::kAnalysis, &track.measurements});
+				}
+			}
+			else {
+				#pragma omp critical
+				std::cerr << "Failed to read standard input" << std::endl;
+				track.failed = true;
+			}
+		}
+		else if (!input.rawHandle()) {
+			#pragma omp critical
+			std::cerr << "Failed to reopen " << filename << " for audio decoding: " << input.strError() << std::endl;
+			track.failed = true;
+		}
+		else if (!track.track_starts.empty()) {
+			track.track_ratings = Rating::Compute(filename, input, track.track_starts, pipeline ? &track.stalls : nullptr);
+			if (ndjson) {
+				// Each track is reported with the time taken by the whole image.
+				const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - track_start).count();
+				const double cpu_seconds = ThreadCpuSeconds() - track_cpu_start;
+				for (std::size_t j = 0; j < track.track_ratings.size(); ++j) {
+					writers[ThreadNum()].Write(TrackReport{track.track_names[j], track.track_ratings[j], track.TrackFrames(j), track.samplerate, wall_seconds, cpu_seconds, ResultSource::kAnalysis});
+				}
+			}
+		}
+		else {
+			if (meter_options.any()) {
+				meters.emplace(track.samplerate, input.channels(), meter_options);
+			}
+			BlockStatistics statistics = speedr::ComputeBlockStatistics(filename, input, [&filename] { return OpenInput(filename); }, threads_per_track, pipeline ? &track.stalls : nullptr, meters ? &*meters : nullptr);
+			if (meters) {
+				track.measurements = meters->Finish();
+			}
+			measure_blocks(track, statistics);
+			const bool keep_statistics = write_sidecars || !track.cache_key.empty();
+			track.rating = Rating::FromBlockStatistics(keep_statistics ? statistics : std::move(statistics));
+			if (write_sidecars && !WriteSidecar(track, statistics)) {
+				track.failed = true;
+			}
+			if (!track.cache_key.empty()) {
+				cache->Store(track.cache_key, CachedResult{track.rating, std::move(statistics), track.frames, track.samplerate});
+				track.cache_key = std::string();
+			}
+			if (ndjson) {
+				const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - track_start).count();
+				writers[ThreadNum()].Write(TrackReport{filename, track.rating, track.frames, track.samplerate, wall_seconds, ThreadCpuSeconds() - track_cpu_start, ResultSource::kAnalysis, &track.measurements});
+			}
+		}
+		busy_seconds[ThreadNum()] += std::chrono::duration<double>(std::chrono::steady_clock::now() - track_start).count();
+	}
+	const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
 	float album_rating = 0.f;
-	for (const auto& [filename, handle, rating]: tracks) {
-		std::cout << filename << ":" << std::endl;
+	PipelineStalls stalls;
+	std::size_t num_rated = 0;
+	const auto report = [&](const std::string& name, const Rating& rating, const Measurements& measurements) {
+		album_rating += rating.final_rating;
+		++num_rated;
+		if (ndjson) return;
+
+		out << name << ":\n";
 		struct RatingPrinter {
+			std::ostream& out;
 			void operator()(const Rating::MonoRating& rating) const {
-				std::cout << "\tRaw DR: " << rating.value << std::endl;
+				out << "\tRaw DR: " << rating.value << '\n';
 			}
 			void operator()(const Rating::StereoRating& rating) const {
-				std::cout << "\tLeft DR: " << rating.left << std::endl;
-				std::cout << "\tRight DR: " << rating.right << std::endl;
+				out << "\tLeft DR: " << rating.left << '\n';
+				out << "\tRight DR: " << rating.right << '\n';
 			}
 			void operator()(const Rating::MultichannelRating& rating) const {
 				for (std::size_t i = 0; i < rating.size(); ++i) {
-					std::cout << "\tChannel " << (i + 1) << ": " << rating[i] << std::endl;
+					out << "\tChannel " << (i + 1) << ": " << rating[i] << '\n';
 				}
 			}
 		};
-		std::visit(RatingPrinter{}, rating.raw_rating);
+		std::visit(RatingPrinter{out}, rating.raw_rating);
 		if (std::isfinite(rating.final_rating)) {
-			std::cout << "\tTrack rating: DR" << rating.final_rating << std::endl;
+			out << "\tTrack rating: DR" << rating.final_rating << '\n';
 		}
 		else {
-			std::cout << "\tTrack rating: N/A" << std::endl;
+			out << "\tTrack rating: N/A\n";
+		}
+		if (const std::optional<speedr::Loudness>& loudness = measurements.loudness) {
+			out << "\tIntegrated loudness: " << loudness->integrated << " LUFS\n";
+			out << "\tLoudness range: " << loudness->range << " LU\n";
+			out << "\tMax momentary loudness: " << loudness->max_momentary << " LUFS\n";
+			out << "\tMax short-term loudness: " << loudness->max_short_term << " LUFS\n";
+		}
+		if (measurements.true_peak) {
+			out << "\tTrue peak: " << *measurements.true_peak << " dBTP\n";
+		}
+		if (const std::optional<speedr::Clipping>& clipping = measurements.clipping) {
+			out << "\tClipped samples: " << clipping->clipped_samples << '\n';
+			out << "\tClipping runs: " << clipping->runs;
+			for (std::size_t i = 0; i < clipping->blocks.size(); ++i) {
+				out << (i == 0 ? " (in blocks " : ", ") << clipping->blocks[i];
+			}
+			out << (clipping->blocks.empty() ? "\n" : ")\n");
+		}
+		if (const std::optional<speedr::StereoImage>& stereo = measurements.stereo) {
+			out << "\tStereo correlation: " << stereo->correlation;
+			// The block most likely to cancel out in mono.
+			const auto lowest = std::min_element(stereo->block_correlations.begin(), stereo->block_correlations.end(), [](const float a, const float b) {
+				return !std::isnan(a) && (std::isnan(b) || a < b);
+			});
+			if (lowest != stereo->block_correlations.end() && !std::isnan(*lowest)) {
+				out << " (lowest: " << *lowest << " in block " << (lowest - stereo->block_correlations.begin()) << ')';
+			}
+			out << "\n\tSide to mid: " << stereo->side_to_mid << " dB\n";
+		}
+		if (const std::optional<speedr::BitDepth>& bit_depth = measurements.bit_depth) {
+			out << "\tEffective bit depth: " << bit_depth->effective_bits << '\n';
+			out << "\tDC offset: ";
+			for (std::size_t i = 0; i < bit_depth->dc_offsets.size(); ++i) {
+				out << (i == 0 ? "" : ", ") << bit_depth->dc_offsets[i];
+			}
+			out << '\n';
+		}
+	};
+	bool any_failed = false;
+	for (const Track& track: tracks) {
+		if (track.failed) {
+			any_failed = true;
+			continue;
+		}
+		stalls += track.stalls;
+		if (track.track_starts.empty()) {
+			report(track.filename, track.rating, track.measurements);
+		}
+		for (std::size_t i = 0; i < track.track_ratings.size(); ++i) {
+			report(track.track_names[i], track.track_ratings[i], Measurements());
 		}
-		album_rating += rating.final_rating;
 	}
 
-	if (tracks.size() > 1) {
-		album_rating = std::round(album_rating / tracks.size());
-		std::cout << std::endl;
+	if (num_rated > 1) {
+		// Kept apart from the NDJSON lines on stdout.
+		std::ostream& summary = ndjson ? std::cerr : out;
+		album_rating = std::round(album_rating / num_rated);
+		if (!ndjson) {
+			summary << '\n';
+		}
 		if (std::isfinite(album_rating)) {
-			std::cout << "Album rating: DR" << album_rating << std::endl;
+			summary << "Album rating: DR" << album_rating << '\n';
 		}
 		else {
-			std::cout << "Album rating: N/A" << std::endl;
+			summary << "Album rating: N/A\n";
 		}
 	}
+
+	if (pipeline) {
+		std::cerr << "Pipeline stalls: decoding waited " << stalls.decoding << " s, analysis waited " << stalls.analysis << " s" << std::endl;
+	}
+	if (report_idle) {
+		const double idle_seconds = num_threads * wall_seconds - std::accumulate(busy_seconds.begin(), busy_seconds.end(), 0.);
+		std::cerr << "Thread idle time: " << idle_seconds << " s over " << num_threads << " threads and " << wall_seconds << " s" << std::endl;
+	}
+
+	return any_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mapped_pcm.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace speedr {
+
+namespace {
+
+constexpr std::size_t kMeteredChunkFrames = 1 << 14;
+
+std::uint64_t ReadUnsigned(const std::uint8_t* bytes, const int size, const bool big_endian) {
+	std::uint64_t value = 0;
+	for (int i = 0; i < size; ++i) {
+		value |= std::uint64_t{bytes[big_endian ? i : size - 1 - i]} << (8 * (size - 1 - i));
+	}
+	return value;
+}
+
+// Where the samples are, and how, once the header has been parsed.
+struct PcmInfo {
+	std::size_t data_offset = 0;
+	std::uint64_t data_size = 0;
+	int channels = 0;
+	int samplerate = 0;
+	PcmLayout layout;
+};
+
+bool IsSupported(const PcmInfo& info) {
+	if (info.channels <= 0 || info.samplerate <= 0) return false;
+	switch (info.layout.encoding) {
+		case PcmLayout::Encoding::kFloat:
+			return info.layout.bytes_per_sample == 4;
+		default:
+			return info.layout.bytes_per_sample >= 1 && info.layout.bytes_per_sample <= 4;
+	}
+}
+
+// 0 and -1, in 32 or 64 bits, stand for the unknown size of a WAV data chunk,
+// left by encoders that cannot seek back to the header.
+bool IsPlaceholderSize(const std::uint64_t size) {
+	return size == 0 || size == 0xFFFFFFFF || size == ~std::uint64_t{0};
+}
+
+// RIFF/WAVE, as well as RF64 and BW64 whose 64-bit sizes are in a "ds64"
+// chunk.
+std::optional<PcmInfo> ParseWav(const std::uint8_t* file, const std::size_t file_size) {
+	const bool is_64_bit = !std::memcmp(file, "RF64", 4) || !std::memcmp(file, "BW64", 4);
+	if (std::memcmp(file, "RIFF", 4) && !is_64_bit) return std::nullopt;
+	if (std::memcmp(&file[8], "WAVE", 4)) return std::nullopt;
+
+	PcmInfo info;
+	bool has_format = false;
+	std::uint64_t ds64_data_size = 0;
+	for (std::size_t offset = 12; offset + 8 <= file_size;) {
+		const std::uint8_t* const chunk = &file[offset];
+		std::uint64_t size = ReadUnsigned(&chunk[4], 4, false);
+		if (!std::memcmp(chunk, "ds64", 4) && offset + 8 + 16 <= file_size) {
+			ds64_data_size = ReadUnsigned(&chunk[8 + 8], 8, false);
+		}
+		else if (!std::memcmp(chunk, "fmt ", 4) && size >= 16 && offset + 8 + size <= file_size) {
+			std::uint64_t format_tag = ReadUnsigned(&chunk[8], 2, false);
+			if (format_tag == 0xFFFE && size >= 26) {
+				// WAVE_FORMAT_EXTENSIBLE: the actual tag starts the subformat GUID.
+				format_tag = ReadUnsigned(&chunk[8 + 24], 2, false);
+			}
+			info.channels = ReadUnsigned(&chunk[8 + 2], 2, false);
+			info.samplerate = ReadUnsigned(&chunk[8 + 4], 4, false);
+			const int bits_per_sample = ReadUnsigned(&chunk[8 + 14], 2, false);
+			info.layout.bytes_per_sample = (bits_per_sample + 7) / 8;
+			info.layout.big_endian = false;
+			switch (format_tag) {
+				case 1:
+					info.layout.encoding = info.layout.bytes_per_sample == 1 ? PcmLayout::Encoding::kUnsignedInteger : PcmLayout::Encoding::kSignedInteger;
+					break;
+				case 3:
+					info.layout.encoding = PcmLayout::Encoding::kFloat;
+					break;
+				default:
+					return std::nullopt;
+			}
+			// Samples are always padded to whole bytes.
+			if (ReadUnsigned(&chunk[8 + 12], 2, false) != static_cast<std::uint64_t>(info.channels * info.layout.bytes_per_sample)) {
+				return std::nullopt;
+			}
+			has_format = true;
+		}
+		else if (!std::memcmp(chunk, "data", 4)) {
+			if (!has_format) return std::nullopt;
+			if (is_64_bit && size == 0xFFFFFFFF) {
+				size = ds64_data_size;
+			}
+			info.data_offset = offset + 8;
+			info.data_size = size;
+			return info;
+		}
+		offset += 8 + size + (size & 1);
+	}
+	return std::nullopt;
+}
+
+// Converts the 80-bit IEEE 754 extended precision number used for the sample
+// rate of AIFF files.
+double ReadExtended(const std::uint8_t* bytes) {
+	const int exponent = ReadUnsigned(bytes, 2, true) & 0x7FFF;
+	const std::uint64_t mantissa = ReadUnsigned(&bytes[2], 8, true);
+	return std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+}
+
+std::optional<PcmInfo> ParseAiff(const std::uint8_t* file, const std::size_t file_size) {
+	if (std::memcmp(file, "FORM", 4)) return std::nullopt;
+	const bool is_aifc = !std::memcmp(&file[8], "AIFC", 4);
+	if (!is_aifc && std::memcmp(&file[8], "AIFF", 4)) return std::nullopt;
+
+	PcmInfo info;
+	bool has_format = false;
+	for (std::size_t offset = 12; offset + 8 <= file_size;) {
+		const std::uint8_t* const chunk = &file[offset];
+		const std::uint64_t size = ReadUnsigned(&chunk[4], 4, true);
+		if (!std::memcmp(chunk, "COMM", 4) && size >= (is_aifc ? 22 : 18) && offset + 8 + size <= file_size) {
+			info.channels = ReadUnsigned(&chunk[8], 2, true);
+			info.layout.bytes_per_sample = (ReadUnsigned(&chunk[8 + 6], 2, true) + 7) / 8;
+			info.samplerate = std::lround(ReadExtended(&chunk[8 + 8]));
+			info.layout.encoding = PcmLayout::Encoding::kSignedInteger;
+			info.layout.big_endian = true;
+			if (is_aifc) {
+				const std::uint8_t* const compression = &chunk[8 + 18];
+				if (!std::memcmp(compression, "sowt", 4)) {
+					info.layout.big_endian = false;
+				}
+				else if (!std::memcmp(compression, "fl32", 4) || !std::memcmp(compression, "FL32", 4)) {
+					info.layout.encoding = PcmLayout::Encoding::kFloat;
+				}
+				else if (std::memcmp(compression, "NONE", 4) && std::memcmp(compression, "twos", 4)) {
+					return std::nullopt;
+				}
+			}
+			has_format = true;
+		}
+		else if (!std::memcmp(chunk, "SSND", 4) && size >= 8 && offset + 16 <= file_size) {
+			if (!has_format) return std::nullopt;
+			const std::uint64_t data_start = ReadUnsigned(&chunk[8], 4, true);
+			if (data_start > size - 8) return std::nullopt;
+			info.data_offset = offset + 16 + data_start;
+			info.data_size = size - 8 - data_start;
+			return info;
+		}
+		offset += 8 + size + (size & 1);
+	}
+	return std::nullopt;
+}
+
+std::optional<PcmInfo> ParseCaf(const std::uint8_t* file, const std::size_t file_size) {
+	if (std::memcmp(file, "caff", 4)) return std::nullopt;
+
+	PcmInfo info;
+	bool has_format = false;
+	for (std::size_t offset = 8; offset + 12 <= file_size;) {
+		const std::uint8_t* const chunk = &file[offset];
+		const std::uint64_t size = ReadUnsigned(&chunk[4], 8, true);
+		// Only the audio data may have a size of -1, which extends it to the
+		// end of the file. Other sizes must fit the file, which also keeps
+		// `offset` from wrapping around.
+		const bool until_end = size == ~std::uint64_t{0};
+		if (until_end ? std::memcmp(chunk, "data", 4) || offset + 16 > file_size : size > file_size - offset - 12) {
+			return std::nullopt;
+		}
+		if (!std::memcmp(chunk, "desc", 4) && size >= 32) {
+			if (std::memcmp(&chunk[12 + 8], "lpcm", 4)) return std::nullopt;
+			std::uint64_t samplerate_bits = ReadUnsigned(&chunk[12], 8, true);
+			double samplerate;
+			std::memcpy(&samplerate, &samplerate_bits, sizeof samplerate);
+			info.samplerate = std::lround(samplerate);
+			const std::uint64_t flags = ReadUnsigned(&chunk[12 + 12], 4, true);
+			info.channels = ReadUnsigned(&chunk[12 + 24], 4, true);
+			info.layout.bytes_per_sample = (ReadUnsigned(&chunk[12 + 28], 4, true) + 7) / 8;
+			info.layout.encoding = flags & 1 ? PcmLayout::Encoding::kFloat : PcmLayout::Encoding::kSignedInteger;
+			info.layout.big_endian = !(flags & 2);
+			if (ReadUnsigned(&chunk[12 + 16], 4, true) != static_cast<std::uint64_t>(info.channels * info.layout.bytes_per_sample)) {
+				return std::nullopt;
+			}
+			has_format = true;
+		}
+		else if (!std::memcmp(chunk, "data", 4) && size >= 4) {
+			if (!has_format) return std::nullopt;
+			// Skips the edit count.
+			info.data_offset = offset + 12 + 4;
+			info.data_size = until_end ? file_size - info.data_offset : size - 4;
+			return info;
+		}
+		offset += 12 + size;
+	}
+	return std::nullopt;
+}
+
+}
+
+std::optional<PcmHeader> ParseWavHeader(const std::uint8_t* bytes, const std::size_t size) {
+	if (size < 12) return std::nullopt;
+	const std::optional<PcmInfo> info = ParseWav(bytes, size);
+	if (!info || !IsSupported(*info) || info->data_offset > size) return std::nullopt;
+	return PcmHeader{info->data_offset, info->channels, info->samplerate, info->layout, IsPlaceholderSize(info->data_size) ? std::nullopt : std::optional(info->data_size)};
+}
+
+std::optional<MappedPcm> MappedPcm::Open(const std::string& filename) {
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return std::nullopt;
+	struct stat status;
+	if (fstat(fd, &status) != 0 || status.st_size < 12) {
+		close(fd);
+		return std::nullopt;
+	}
+	const auto file_size = static_cast<std::size_t>(status.st_size);
+	void* const mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return std::nullopt;
+
+	MappedPcm pcm;
+	pcm.mapping_ = mapping;
+	pcm.mapping_size_ = file_size;
+	const auto* const file = static_cast<const std::uint8_t*>(mapping);
+	std::optional<PcmInfo> info = ParseWav(file, file_size);
+	// Such samples run to the end of the file, as in a stream.
+	if (info && IsPlaceholderSize(info->data_size)) {
+		info->data_size = ~std::uint64_t{0};
+	}
+	if (!info) info = ParseAiff(file, file_size);
+	if (!info) info = ParseCaf(file, file_size);
+	if (!info || !IsSupported(*info) || info->data_offset > file_size) return std::nullopt;
+
+	madvise(mapping, file_size, MADV_SEQUENTIAL);
+	const std::size_t frame_size = info->channels * info->layout.bytes_per_sample;
+	pcm.data_ = &file[info->data_offset];
+	pcm.frames_ = std::min<std::uint64_t>(info->data_size, file_size - info->data_offset) / frame_size;
+	pcm.channels_ = info->channels;
+	pcm.samplerate_ = info->samplerate;
+	pcm.layout_ = info->layout;
+	return pcm;
+}
+
+MappedPcm::MappedPcm(MappedPcm&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedPcm& MappedPcm::operator=(MappedPcm&& other) noexcept {
+	std::swap(mapping_, other.mapping_);
+	std::swap(mapping_size_, other.mapping_size_);
+	data_ = other.data_;
+	frames_ = other.frames_;
+	channels_ = other.channels_;
+	samplerate_ = other.samplerate_;
+	layout_ = other.layout_;
+	return *this;
+}
+
+MappedPcm::~MappedPcm() {
+	if (mapping_) {
+		munmap(mapping_, mapping_size_);
+	}
+}
+
+BlockStatistics MappedPcm::ComputeBlockStatistics(const std::uint64_t first_frame, const std::uint64_t end_frame, Meters* const meters) const {
+	const std::size_t frame_size = channels_ * layout_.bytes_per_sample;
+	const std::uint8_t* const bytes = &data_[std::min(first_frame, frames_) * frame_size];
+	const std::uint64_t frames = std::min(end_frame, frames_) - std::min(first_frame, frames_);
+	const auto accumulate = [&](auto accumulator) {
+		if (!meters) {
+			accumulator.Push(bytes, frames, layout_);
+			return accumulator.FinishBlocks();
+		}
+		// In chunks that the meters read again while they are still in cache.
+		for (std::uint64_t offset = 0; offset < frames; offset += kMeteredChunkFrames) {
+			const std::size_t n = std::min<std::uint64_t>(frames - offset, kMeteredChunkFrames);
+			accumulator.Push(&bytes[offset * frame_size], n, layout_);
+			meters->Push(&bytes[offset * frame_size], n, layout_);
+		}
+		return accumulator.FinishBlocks();
+	};
+
+	if (layout_.encoding == PcmLayout::Encoding::kFloat || layout_.bytes_per_sample == 4) {
+		return accumulate(DrAccumulator(samplerate_, channels_));
+	}
+	return accumulate(IntegerDrAccumulator(samplerate_, channels_, 8 * layout_.bytes_per_sample));
+}
+
+void MappedPcm::Meter(Meters& meters) const {
+	meters.Push(data_, frames_, layout_);
+}
+
+std::uint64_t MappedPcm::HashSamples() const {
+	const std::size_t size = frames_ * channels_ * layout_.bytes_per_sample;
+	std::uint64_t hash = size;
+	const auto mix = [&hash](const std::uint64_t word) {
+		const std::uint64_t mixed = hash ^ (word * 0x9E3779B97F4A7C15);
+		hash = ((mixed << 31) | (mixed >> 33)) * 0xBF58476D1CE4E5B9;
+	};
+	std::size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		std::uint64_t word;
+		std::memcpy(&word, &data_[i], sizeof word);
+		mix(word);
+	}
+	std::uint64_t tail = 0;
+	std::memcpy(&tail, &data_[i], size - i);
+	mix(tail);
+	hash ^= hash >> 29;
+	hash *= 0x94D049BB133111EB;
+	return hash ^ (hash >> 32);
+}
+
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "compute_dr.h"
+#include "meters.h"
+
+namespace speedr {
+
+// How the samples of a WAV stream are stored, and where they start.
+struct PcmHeader {
+	std::size_t data_offset;
+	int channels;
+	int samplerate;
+	PcmLayout layout;
+	// In bytes, unless the header leaves it to the end of the stream with a
+	// placeholder size, as written by encoders that cannot seek back to it.
+	std::optional<std::uint64_t> data_size;
+};
+
+// From the first `size` bytes of a WAV, RF64 or BW64 stream, once they cover
+// its header. Returns nothing if the header is incomplete or the samples are
+// not supported.
+std::optional<PcmHeader> ParseWavHeader(const std::uint8_t* bytes, std::size_t size);
+
+// The sample data of an uncompressed WAV, RF64, AIFF or CAF file, mapped into
+// memory so that it can be analysed in place rather than read through
+// libsndfile.
+class MappedPcm {
+public:
+	// Returns nothing if the file is not of one of those types, or if its
+	// samples are not plain integers of up to 32 bits or 32-bit floats.
+	static std::optional<MappedPcm> Open(const std::string& filename);
+
+	MappedPcm(MappedPcm&& other) noexcept;
+	MappedPcm& operator=(MappedPcm&& other) noexcept;
+	~MappedPcm();
+
+	std::uint64_t frames() const { return frames_; }
+	int channels() const { return channels_; }
+	int samplerate() const { return samplerate_; }
+	const PcmLayout& layout() const { return layout_; }
+
+	// Of frames `first_frame` to `end_frame` (excluded), which are also pushed
+	// to `meters` if given.
+	BlockStatistics ComputeBlockStatistics(std::uint64_t first_frame, std::uint64_t end_frame, Meters* meters = nullptr) const;
+	// Pushes all of the frames to `meters`, e.g. on a thread of their own while
+	// ranges of frames are analysed without them.
+	void Meter(Meters& meters) const;
+	// Non-cryptographic 64-bit hash of the sample data alone, which metadata
+	// chunks do not affect.
+	std::uint64_t HashSamples() const;
+
+private:
+	MappedPcm() = default;
+
+	void* mapping_ = nullptr;
+	std::size_t mapping_size_ = 0;
+	const std::uint8_t* data_ = nullptr;
+	std::uint64_t frames_ = 0;
+	int channels_ = 0;
+	int samplerate_ = 0;
+	PcmLayout layout_;
+};
+
+}
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "meters.h"
+
+#include <algorithm>
+
+namespace speedr {
+
+namespace {
+
+constexpr std::size_t kChunkFrames = 4096;
+
+}
+
+Meters::Meters(const int samplerate, const int num_channels, const MeterOptions& options)
+	: samplerate_(samplerate),
+	  num_channels_(num_channels),
+	  options_(options) {
+	if (options.loudness) {
+		loudness_.emplace(samplerate, num_channels);
+	}
+	if (options.true_peak) {
+		true_peak_.emplace(num_channels);
+	}
+	if (options.stereo && num_channels == 2) {
+		stereo_.emplace(samplerate);
+	}
+}
+
+template <typename Convert>
+void Meters::PushConverted(const std::size_t frames, const Convert& convert) {
+	converted_.resize(kChunkFrames * num_channels_);
+	for (std::size_t offset = 0; offset < frames; offset += kChunkFrames) {
+		const std::size_t n = std::min(frames - offset, kChunkFrames);
+		convert(offset, n, converted_.data());
+		PushFloats(converted_.data(), n);
+	}
+}
+
+void Meters::Push(const float* interleaved, const std::size_t frames) {
+	PushFloats(interleaved, frames);
+}
+
+void Meters::PushFloats(const float* interleaved, const std::size_t frames) {
+	if (loudness_) {
+		loudness_->Push(interleaved, frames);
+	}
+	if (true_peak_) {
+		true_peak_->Push(interleaved, frames);
+	}
+	if (stereo_) {
+		stereo_->Push(interleaved, frames);
+	}
+}
+
+void Meters::Push(const std::int16_t* interleaved, const std::size_t frames) {
+	PushConverted(frames, [&](const std::size_t offset, const std::size_t n, float* const converted) {
+		ConvertSamples(&interleaved[offset * num_channels_], n * num_channels_, converted);
+	});
+}
+
+void Meters::PushLeftAligned(const std::int32_t* interleaved, const std::size_t frames) {
+	PushConverted(frames, [&](const std::size_t offset, const std::size_t n, float* const converted) {
+		ConvertSamples(&interleaved[offset * num_channels_], n * num_channels_, 32, converted);
+	});
+}
+
+void Meters::PushPlanar(const std::int32_t* const* channels, const std::size_t frames, const int bits_per_sample) {
+	planar_.resize(kChunkFrames);
+	PushConverted(frames, [&](const std::size_t offset, const std::size_t n, float* const converted) {
+		for (int c = 0; c < num_channels_; ++c) {
+			ConvertSamples(&channels[c][offset], n, bits_per_sample, planar_.data());
+			for (std::size_t i = 0; i < n; ++i) {
+				converted[i * num_channels_ + c] = planar_[i];
+			}
+		}
+	});
+}
+
+void Meters::Push(const std::uint8_t* interleaved, const std::size_t frames, const PcmLayout& layout) {
+	const std::size_t frame_size = num_channels_ * layout.bytes_per_sample;
+	PushConverted(frames, [&](const std::size_t offset, const std::size_t n, float* const converted) {
+		ConvertSamples(&interleaved[offset * frame_size], n * num_channels_, layout, converted);
+	});
+}
+
+void Meters::Restart() {
+	*this = Meters(samplerate_, num_channels_, options_);
+}
+
+Measurements Meters::Finish() const {
+	Measurements measurements;
+	if (loudness_) {
+		measurements.loudness = loudness_->Finish();
+	}
+	if (true_peak_) {
+		measurements.true_peak = true_peak_->Finish();
+	}
+	if (stereo_) {
+		measurements.stereo = stereo_->Finish();
+	}
+	return measurements;
+}
+
+}
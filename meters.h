@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "bit_depth.h"
+#include "clipping.h"
+#include "compute_dr.h"
+#include "loudness.h"
+#include "stereo.h"
+#include "true_peak.h"
+
+namespace speedr {
+
+// What to measure of each track besides its DR.
+struct MeterOptions {
+	bool loudness = false;
+	bool true_peak = false;
+	// Only of stereo tracks.
+	bool stereo = false;
+
+	bool any() const { return loudness || true_peak || stereo; }
+};
+
+// What was measured of a track, for the measures enabled in its MeterOptions,
+// and what was found in its block statistics.
+struct Measurements {
+	std::optional<Loudness> loudness;
+	// In dBTP.
+	std::optional<double> true_peak;
+	std::optional<StereoImage> stereo;
+	std::optional<Clipping> clipping;
+	std::optional<BitDepth> bit_depth;
+};
+
+// Takes the measures enabled in its options from samples pushed in chunks of
+// any size, in the same forms as to DrAccumulator and IntegerDrAccumulator, so
+// that it can be fed the buffers read for them in the same pass. Unlike their
+// block statistics, the measures follow the samples from start to end, which
+// must therefore be pushed in order and in a single range.
+class Meters {
+public:
+	Meters(int samplerate, int num_channels, const MeterOptions& options);
+
+	void Push(const float* interleaved, std::size_t frames);
+	void Push(const std::int16_t* interleaved, std::size_t frames);
+	// Samples occupy the most significant bits of each int32, as returned by
+	// libsndfile.
+	void PushLeftAligned(const std::int32_t* interleaved, std::size_t frames);
+	// One buffer per channel, with samples within ±2^(bits_per_sample - 1).
+	void PushPlanar(const std::int32_t* const* channels, std::size_t frames, int bits_per_sample);
+	// For any of the layouts of PcmLayout.
+	void Push(const std::uint8_t* interleaved, std::size_t frames, const PcmLayout& layout);
+	// Forgets the samples pushed so far, e.g. when reading them one way fails
+	// and they are read again another way.
+	void Restart();
+	Measurements Finish() const;
+
+private:
+	// Calls `convert(offset, n, converted)` to convert frames to floats in
+	// chunks, and pushes each chunk.
+	template <typename Convert>
+	void PushConverted(std::size_t frames, const Convert& convert);
+	void PushFloats(const float* interleaved, std::size_t frames);
+
+	int samplerate_;
+	int num_channels_;
+	MeterOptions options_;
+	std::vector<float> converted_;
+	// One channel of a chunk pushed by PushPlanar.
+	std::vector<float> planar_;
+	std::optional<LoudnessMeter> loudness_;
+	std::optional<TruePeakMeter> true_peak_;
+	std::optional<StereoMeter> stereo_;
+};
+
+}
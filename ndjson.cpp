@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ndjson.h"
+
+#include <cmath>
+#include <vector>
+
+namespace speedr {
+
+namespace {
+
+void AppendString(std::string& out, const std::string& value) {
+	out += '"';
+	for (const char c: value) {
+		switch (c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char escaped[8];
+					std::snprintf(escaped, sizeof escaped, "\\u%04x", c);
+					out += escaped;
+				}
+				else {
+					out += c;
+				}
+		}
+	}
+	out += '"';
+}
+
+void AppendNumber(std::string& out, const double value) {
+	if (!std::isfinite(value)) {
+		out += "null";
+		return;
+	}
+	char formatted[32];
+	std::snprintf(formatted, sizeof formatted, "%.9g", value);
+	out += formatted;
+}
+
+void AppendNdjson(std::string& line, const TrackReport& report) {
+	line += "{\"path\":";
+	AppendString(line, report.path);
+	line += ",\"channels_dr\":[";
+	const std::vector<float> channel_ratings = report.rating.ChannelRatings();
+	for (std::size_t i = 0; i < channel_ratings.size(); ++i) {
+		if (i > 0) line += ',';
+		AppendNumber(line, channel_ratings[i]);
+	}
+	line += "],\"track_dr\":";
+	AppendNumber(line, report.rating.final_rating);
+	line += ",\"frames\":";
+	line += std::to_string(report.frames);
+	line += ",\"samplerate\":";
+	line += std::to_string(report.samplerate);
+	line += ",\"wall_seconds\":";
+	AppendNumber(line, report.wall_seconds);
+	line += ",\"cpu_seconds\":";
+	AppendNumber(line, report.cpu_seconds);
+	line += ",\"cached\":";
+	line += report.source == ResultSource::kCache ? "true" : "false";
+	line += ",\"source\":";
+	switch (report.source) {
+		case ResultSource::kAnalysis: line += "\"analysis\""; break;
+		case ResultSource::kCache: line += "\"cache\""; break;
+		case ResultSource::kSidecar: line += "\"sidecar\""; break;
+	}
+	if (report.measurements && report.measurements->loudness) {
+		const Loudness& loudness = *report.measurements->loudness;
+		line += ",\"integrated_loudness\":";
+		AppendNumber(line, loudness.integrated);
+		line += ",\"loudness_range\":";
+		AppendNumber(line, loudness.range);
+		line += ",\"max_momentary_loudness\":";
+		AppendNumber(line, loudness.max_momentary);
+		line += ",\"max_short_term_loudness\":";
+		AppendNumber(line, loudness.max_short_term);
+	}
+	if (report.measurements && report.measurements->true_peak) {
+		line += ",\"true_peak\":";
+		AppendNumber(line, *report.measurements->true_peak);
+	}
+	if (report.measurements && report.measurements->clipping) {
+		const Clipping& clipping = *report.measurements->clipping;
+		line += ",\"clipped_samples\":";
+		line += std::to_string(clipping.clipped_samples);
+		line += ",\"clipping_runs\":";
+		line += std::to_string(clipping.runs);
+		line += ",\"clipping_blocks\":[";
+		for (std::size_t i = 0; i < clipping.blocks.size(); ++i) {
+			if (i > 0) line += ',';
+			line += std::to_string(clipping.blocks[i]);
+		}
+		line += ']';
+	}
+	if (report.measurements && report.measurements->stereo) {
+		const StereoImage& stereo = *report.measurements->stereo;
+		line += ",\"stereo_correlation\":";
+		AppendNumber(line, stereo.correlation);
+		line += ",\"side_to_mid\":";
+		AppendNumber(line, stereo.side_to_mid);
+		line += ",\"block_correlations\":[";
+		for (std::size_t i = 0; i < stereo.block_correlations.size(); ++i) {
+			if (i > 0) line += ',';
+			AppendNumber(line, stereo.block_correlations[i]);
+		}
+		line += "],\"block_side_to_mid\":[";
+		for (std::size_t i = 0; i < stereo.block_side_to_mid.size(); ++i) {
+			if (i > 0) line += ',';
+			AppendNumber(line, stereo.block_side_to_mid[i]);
+		}
+		line += ']';
+	}
+	if (report.measurements && report.measurements->bit_depth) {
+		const BitDepth& bit_depth = *report.measurements->bit_depth;
+		line += ",\"effective_bits\":";
+		line += std::to_string(bit_depth.effective_bits);
+		line += ",\"dc_offsets\":[";
+		for (std::size_t i = 0; i < bit_depth.dc_offsets.size(); ++i) {
+			if (i > 0) line += ',';
+			AppendNumber(line, bit_depth.dc_offsets[i]);
+		}
+		line += ']';
+	}
+	line += "}\n";
+}
+
+}
+
+void NdjsonWriter::Write(const TrackReport& report) {
+	buffer_.clear();
+	AppendNdjson(buffer_, report);
+	std::fwrite(buffer_.data(), 1, buffer_.size(), output_);
+	std::fflush(output_);
+}
+
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "compute_dr.h"
+#include "meters.h"
+
+namespace speedr {
+
+// Where the results reported about a track come from.
+enum class ResultSource {
+	kAnalysis,
+	kCache,
+	kSidecar,
+};
+
+// What is reported about an analysed track.
+struct TrackReport {
+	const std::string& path;
+	const Rating& rating;
+	std::uint64_t frames;
+	int samplerate;
+	double wall_seconds;
+	// Of the thread that analysed the track, excluding any other threads
+	// that decoded ranges of it.
+	double cpu_seconds;
+	ResultSource source;
+	const Measurements* measurements = nullptr;
+};
+
+// Writes reports to `output` for one thread, as one JSON object per line:
+// {"path": ..., "channels_dr": [...], "track_dr": ..., "frames": ...,
+// "samplerate": ..., "wall_seconds": ..., "cpu_seconds": ..., "cached": ...,
+// "source": ...}, where "cached" tells results from the cache and "source" is
+// "analysis", "cache" or "sidecar", followed, if measured, by
+// "integrated_loudness", "loudness_range", "max_momentary_loudness" and
+// "max_short_term_loudness", by "true_peak", by "clipped_samples",
+// "clipping_runs" and "clipping_blocks" (an array), by "stereo_correlation",
+// "side_to_mid", "block_correlations" and "block_side_to_mid" (arrays), and by
+// "effective_bits" and "dc_offsets" (an array), where values that are not
+// finite are null. Lines are formatted into a buffer owned by the writer and
+// handed to `output` in a single call once complete, so that writers of
+// different threads can share `output` without interleaving their lines or
+// taking any lock besides that of stdio.
+class NdjsonWriter {
+public:
+	explicit NdjsonWriter(std::FILE* output) : output_(output) {}
+
+	// Emits the line immediately, so that it can be consumed while the other
+	// tracks are still being analysed.
+	void Write(const TrackReport& report);
+
+private:
+	std::FILE* output_;
+	std::string buffer_;
+};
+
+}
@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "raw_pcm.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+#include <unistd.h>
+#endif
+
+#ifdef SPEEDR_HAVE_MMAP
+#include "mapped_pcm.h"
+#endif
+
+namespace speedr {
+
+namespace {
+
+constexpr std::size_t kReadSize = 1 << 20;
+
+bool WriteAll(const int fd, const std::uint8_t* bytes, std::size_t size) {
+	while (size > 0) {
+#ifdef _WIN32
+		const int written = _write(fd, bytes, static_cast<unsigned>(std::min<std::size_t>(size, kReadSize)));
+#else
+		const ssize_t written = write(fd, bytes, size);
+#endif
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		bytes += written;
+		size -= written;
+	}
+	return true;
+}
+
+// Calls `analyse(accumulator)` with an accumulator for `format`, integer for
+// integers of up to 24 bits.
+template <typename Analyse>
+auto WithAccumulator(const RawPcmFormat& format, const Analyse& analyse) {
+	if (format.layout.encoding != PcmLayout::Encoding::kFloat && format.layout.bytes_per_sample <= 3) {
+		return analyse(IntegerDrAccumulator(format.samplerate, format.channels, 8 * format.layout.bytes_per_sample));
+	}
+	return analyse(DrAccumulator(format.samplerate, format.channels));
+}
+
+}
+
+std::optional<PcmLayout> GetRawPcmLayout(const std::string& name) {
+	const bool big_endian = false;
+	if (name == "s16le") return PcmLayout{PcmLayout::Encoding::kSignedInteger, 2, big_endian};
+	if (name == "s24le") return PcmLayout{PcmLayout::Encoding::kSignedInteger, 3, big_endian};
+	if (name == "s32le") return PcmLayout{PcmLayout::Encoding::kSignedInteger, 4, big_endian};
+	if (name == "f32le") return PcmLayout{PcmLayout::Encoding::kFloat, 4, big_endian};
+	return std::nullopt;
+}
+
+std::optional<PcmStream> PcmStream::Open(const int fd, const std::optional<RawPcmFormat>& format, const int tee_fd) {
+#ifdef _WIN32
+	_setmode(fd, _O_BINARY);
+	if (tee_fd >= 0) {
+		_setmode(tee_fd, _O_BINARY);
+	}
+#endif
+	PcmStream stream(fd, tee_fd);
+	if (format) {
+		stream.format_ = *format;
+		return stream;
+	}
+#ifdef SPEEDR_HAVE_MMAP
+	// Headers are rarely more than a few kilobytes, but can be padded.
+	std::vector<std::uint8_t> header(kReadSize);
+	std::size_t size = 0;
+	while (size < header.size()) {
+		const long long bytes_read = stream.Read(&header[size], header.size() - size);
+		if (bytes_read <= 0) break;
+		size += bytes_read;
+		if (const std::optional<PcmHeader> wav = ParseWavHeader(header.data(), size)) {
+			stream.format_ = RawPcmFormat{wav->layout, wav->samplerate, wav->channels};
+			stream.data_size_ = wav->data_size;
+			stream.pending_.assign(header.begin() + wav->data_offset, header.begin() + size);
+			return stream;
+		}
+	}
+#endif
+	stream.Drain();
+	return std::nullopt;
+}
+
+long long PcmStream::Read(std::uint8_t* const bytes, const std::size_t size) {
+	for (;;) {
+#ifdef __linux__
+		if (tee_fd_ >= 0 && can_tee_) {
+			// Duplicates the data into the output pipe without copying it, then
+			// consumes what was duplicated.
+			const ssize_t duplicated = tee(fd_, tee_fd_, size, 0);
+			if (duplicated < 0) {
+				if (errno == EINTR) continue;
+				if (errno != EINVAL) return -1;
+				can_tee_ = false;
+				continue;
+			}
+			std::size_t bytes_read = 0;
+			while (bytes_read < static_cast<std::size_t>(duplicated)) {
+				const ssize_t n = read(fd_, &bytes[bytes_read], duplicated - bytes_read);
+				if (n < 0 && errno == EINTR) continue;
+				if (n <= 0) return -1;
+				bytes_read += n;
+			}
+			return duplicated;
+		}
+#endif
+#ifdef _WIN32
+		const int bytes_read = _read(fd_, bytes, static_cast<unsigned>(size));
+#else
+		const ssize_t bytes_read = read(fd_, bytes, size);
+#endif
+		if (bytes_read < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		if (tee_fd_ >= 0 && !WriteAll(tee_fd_, bytes, bytes_read)) return -1;
+		return bytes_read;
+	}
+}
+
+bool PcmStream::ReadFrames(const std::function<void(const std::uint8_t*, std::size_t)>& consume) {
+	const std::size_t frame_size = format_.channels * format_.layout.bytes_per_sample;
+	std::vector<std::uint8_t> buffer(std::max({kReadSize, 2 * frame_size, pending_.size()}));
+	std::size_t size = pending_.size();
+	std::copy(pending_.begin(), pending_.end(), buffer.begin());
+	pending_ = std::vector<std::uint8_t>();
+	std::uint64_t data_left = data_size_.value_or(std::numeric_limits<std::uint64_t>::max());
+	for (;;) {
+		const std::size_t frames = std::min<std::uint64_t>(size, data_left) / frame_size;
+		if (frames > 0) {
+			consume(buffer.data(), frames);
+			// Keeps the bytes of a partial frame for the next read.
+			std::memmove(buffer.data(), &buffer[frames * frame_size], size - frames * frame_size);
+			size -= frames * frame_size;
+			data_left -= frames * frame_size;
+		}
+		if (data_left < frame_size) {
+			// What follows the samples, such as metadata chunks, is not audio,
+			// and only read for the copy.
+			if (tee_fd_ < 0) return true;
+			size = 0;
+		}
+		const long long bytes_read = Read(&buffer[size], buffer.size() - size);
+		if (bytes_read < 0) return false;
+		if (bytes_read == 0) return true;
+		size += bytes_read;
+	}
+}
+
+std::optional<BlockStatistics> PcmStream::ComputeBlockStatistics(std::uint64_t* const frames, Meters* const meters) {
+	return WithAccumulator(format_, [&](auto accumulator) -> std::optional<BlockStatistics> {
+		std::uint64_t frames_read = 0;
+		const bool read = ReadFrames([&](const std::uint8_t* const bytes, const std::size_t n) {
+			accumulator.Push(bytes, n, format_.layout);
+			if (meters) {
+				meters->Push(bytes, n, format_.layout);
+			}
+			frames_read += n;
+		});
+		if (!read) return std::nullopt;
+		if (frames) {
+			*frames = frames_read;
+		}
+		return accumulator.FinishBlocks();
+	});
+}
+
+bool PcmStream::Stream(const std::function<void(const BlockStatistics&)>& on_blocks) {
+	return WithAccumulator(format_, [&](auto accumulator) {
+		return ReadFrames([&](const std::uint8_t* const bytes, const std::size_t n) {
+			accumulator.Push(bytes, n, format_.layout);
+			const BlockStatistics statistics = accumulator.TakeBlocks();
+			if (!statistics.mean_square[0].empty()) {
+				on_blocks(statistics);
+			}
+		});
+	});
+}
+
+bool PcmStream::Drain() {
+	if (tee_fd_ < 0) return true;
+	std::vector<std::uint8_t> buffer(kReadSize);
+	for (;;) {
+		const long long bytes_read = Read(buffer.data(), buffer.size());
+		if (bytes_read <= 0) return bytes_read == 0;
+	}
+}
+
+}
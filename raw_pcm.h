@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "compute_dr.h"
+#include "meters.h"
+
+namespace speedr {
+
+// Interleaved samples without any header, such as those that decoders write
+// to a pipe, read from a file descriptor until its end.
+struct RawPcmFormat {
+	PcmLayout layout;
+	int samplerate;
+	int channels;
+};
+
+// Names of the layouts, as with ffmpeg's -f: s16le, s24le, s32le or f32le.
+std::optional<PcmLayout> GetRawPcmLayout(const std::string& name);
+
+// Samples read from a file descriptor as they come, with reads as large as
+// the data available allows, until its end. They can also be copied as is,
+// along with any header, to another file descriptor as they are read, which
+// lets the analysis sit between a decoder and an encoder.
+class PcmStream {
+public:
+	// Reads raw samples in `format` if given, and otherwise a WAV header first,
+	// which is only supported when built with memory mapping. Samples then end
+	// where the header says, if it gives their size, and any chunks after them
+	// are only copied. Returns nothing if the header cannot be read or is not
+	// supported, after copying the rest of the stream to `tee_fd` if given, so
+	// that the next stage of a pipe still gets all of it.
+	static std::optional<PcmStream> Open(int fd, const std::optional<RawPcmFormat>& format, int tee_fd = -1);
+
+	const RawPcmFormat& format() const { return format_; }
+
+	// Reads the stream to its end, feeding `meters` too if given, and sets
+	// `*frames` to the number of frames read. Returns nothing if a read or the
+	// copy fails.
+	std::optional<BlockStatistics> ComputeBlockStatistics(std::uint64_t* frames = nullptr, Meters* meters = nullptr);
+	// Like StreamBlockStatistics. Returns false if a read or the copy fails.
+	bool Stream(const std::function<void(const BlockStatistics&)>& on_blocks);
+	// Copies what is left of the stream to the tee output, if any, without
+	// analysing it, e.g. before giving up on other inputs. Returns false if a
+	// read or the copy fails.
+	bool Drain();
+
+private:
+	PcmStream(int fd, int tee_fd): fd_(fd), tee_fd_(tee_fd) {}
+
+	// Reads up to `size` bytes and copies them to `tee_fd_`. Returns 0 at the
+	// end of the stream and -1 on failure.
+	long long Read(std::uint8_t* bytes, std::size_t size);
+	// Calls `consume(bytes, frames)` with the whole frames of each read.
+	bool ReadFrames(const std::function<void(const std::uint8_t*, std::size_t)>& consume);
+
+	int fd_;
+	int tee_fd_;
+	// Whether both ends are pipes between which tee(2) can duplicate the data.
+	bool can_tee_ = true;
+	RawPcmFormat format_ = {};
+	// In bytes, if known from the header.
+	std::optional<std::uint64_t> data_size_;
+	// Read along with the header.
+	std::vector<std::uint8_t> pending_;
+};
+
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sidecar.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "binary_io.h"
+
+namespace speedr {
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'P', 'D', 'R', 'B', 'L', 'K', 'S'};
+constexpr std::uint32_t kFormatVersion = 2;
+// Reads back differently on a machine of the other byte order.
+constexpr std::uint32_t kByteOrderMark = 0x01020304;
+
+}
+
+bool WriteSidecar(const std::string& filename, const Sidecar& sidecar) {
+	const auto num_channels = static_cast<std::uint32_t>(sidecar.statistics.mean_square.size());
+	const std::uint64_t num_blocks = num_channels == 0 ? 0 : sidecar.statistics.mean_square[0].size();
+	ByteWriter writer;
+	writer.WriteBytes(std::string(kMagic, sizeof kMagic));
+	writer.Write(kFormatVersion);
+	writer.Write(kByteOrderMark);
+	writer.Write(static_cast<std::uint32_t>(sidecar.samplerate));
+	writer.Write(static_cast<std::uint32_t>(sidecar.block_size));
+	writer.Write(sidecar.frames);
+	writer.Write(num_channels);
+	writer.Write(num_blocks);
+	for (std::uint32_t c = 0; c < num_channels; ++c) {
+		writer.WriteArray(sidecar.statistics.mean_square[c]);
+	}
+	for (std::uint32_t c = 0; c < num_channels; ++c) {
+		writer.WriteArray(sidecar.statistics.peak[c]);
+	}
+	BlockIndex(sidecar.statistics).Serialize(writer);
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	file.write(writer.bytes().data(), writer.bytes().size());
+	file.close();
+	return static_cast<bool>(file);
+}
+
+std::optional<Sidecar> ReadSidecar(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return std::nullopt;
+	const std::string bytes(std::istreambuf_iterator<char>(file), {});
+	ByteReader reader(bytes);
+
+	char magic[sizeof kMagic];
+	std::uint32_t version, byte_order_mark, samplerate, block_size, num_channels;
+	std::uint64_t num_blocks;
+	Sidecar sidecar;
+	if (!reader.Read(magic) || std::memcmp(magic, kMagic, sizeof kMagic) != 0 || !reader.Read(version) || version != kFormatVersion || !reader.Read(byte_order_mark) || byte_order_mark != kByteOrderMark) {
+		return std::nullopt;
+	}
+	if (!reader.Read(samplerate) || !reader.Read(block_size) || !reader.Read(sidecar.frames) || !reader.Read(num_channels) || num_channels == 0 || !reader.Read(num_blocks) || num_blocks == 0) {
+		return std::nullopt;
+	}
+	sidecar.samplerate = samplerate;
+	sidecar.block_size = block_size;
+	sidecar.statistics.mean_square.resize(num_channels);
+	sidecar.statistics.peak.resize(num_channels);
+	for (std::vector<float>& mean_square: sidecar.statistics.mean_square) {
+		if (!reader.ReadArray(mean_square, num_blocks)) return std::nullopt;
+	}
+	for (std::vector<float>& peak: sidecar.statistics.peak) {
+		if (!reader.ReadArray(peak, num_blocks)) return std::nullopt;
+	}
+	std::optional<BlockIndex> index = BlockIndex::Deserialize(reader, num_channels, num_blocks);
+	if (!index) return std::nullopt;
+	sidecar.index = std::move(*index);
+	return sidecar;
+}
+
+}
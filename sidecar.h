@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "block_index.h"
+#include "compute_dr.h"
+
+namespace speedr {
+
+// Extension appended to the name of an audio file for its sidecar.
+inline constexpr char kSidecarExtension[] = ".speedr";
+
+// The per-block statistics of a track, from which its rating and that of any
+// group of tracks can be computed again without decoding it.
+struct Sidecar {
+	BlockStatistics statistics;
+	std::uint64_t frames;
+	int samplerate;
+	int block_size;
+	// Read back along with the statistics; built from them when writing.
+	BlockIndex index = {};
+};
+
+// Sidecars are binary files made of a versioned header (magic, version, byte
+// order mark, sample rate, block size, frames, channels and blocks) followed
+// by the mean squares, then the peaks, of each channel, as float arrays, and
+// by the index of these statistics.
+bool WriteSidecar(const std::string& filename, const Sidecar& sidecar);
+// Returns nothing if `filename` cannot be read or is not a sidecar of this
+// version written on a machine with the same byte order.
+std::optional<Sidecar> ReadSidecar(const std::string& filename);
+
+}
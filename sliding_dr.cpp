@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sliding_dr.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+namespace speedr {
+
+namespace {
+
+constexpr float kNoPeak = -std::numeric_limits<float>::infinity();
+
+}
+
+SlidingDrMeter::SlidingDrMeter(const int num_channels, const std::size_t window_blocks)
+	: window_blocks_(std::max<std::size_t>(1, window_blocks)),
+	  window_mean_squares_(num_channels),
+	  mean_squares_(num_channels),
+	  peaks_(num_channels) {}
+
+void SlidingDrMeter::Push(const BlockStatistics& statistics, const std::size_t block) {
+	const bool full = num_blocks_ == window_blocks_;
+	if (!full) {
+		++num_blocks_;
+	}
+	for (std::size_t c = 0; c < mean_squares_.size(); ++c) {
+		std::deque<float>& window = window_mean_squares_[c];
+		if (full) {
+			mean_squares_[c].Erase(window.front());
+			window.pop_front();
+			peaks_[c].Pop();
+		}
+		window.push_back(statistics.mean_square[c][block]);
+		mean_squares_[c].Insert(window.back());
+		mean_squares_[c].Resize(std::max<std::size_t>(1, num_blocks_ / 5));
+		peaks_[c].Push(statistics.peak[c][block]);
+	}
+}
+
+Rating SlidingDrMeter::Rate() const {
+	std::vector<float> ratings;
+	ratings.reserve(mean_squares_.size());
+	for (std::size_t c = 0; c < mean_squares_.size(); ++c) {
+		const MeanSquares& mean_squares = mean_squares_[c];
+		// The doubling corresponds to AES17 calibration (+3dB)
+		const float average_mean_square = static_cast<float>(mean_squares.sum_of_largest) * 2.f / mean_squares.largest.size();
+		const TopPeaks top_peaks = peaks_[c].Top();
+		// A single block is rated on its own peak.
+		const float peak = num_blocks_ == 1 ? top_peaks.largest : top_peaks.second_largest;
+		ratings.push_back(10 * std::log10(peak * peak / average_mean_square));
+	}
+	return Rating::FromChannelRatings(std::move(ratings));
+}
+
+void SlidingDrMeter::MeanSquares::Insert(const float mean_square) {
+	if (!largest.empty() && mean_square > *largest.begin()) {
+		largest.insert(mean_square);
+		sum_of_largest += mean_square;
+	}
+	else {
+		others.insert(mean_square);
+	}
+}
+
+void SlidingDrMeter::MeanSquares::Erase(const float mean_square) {
+	if (!largest.empty() && mean_square >= *largest.begin()) {
+		largest.erase(largest.find(mean_square));
+		sum_of_largest -= mean_square;
+	}
+	else {
+		others.erase(others.find(mean_square));
+	}
+}
+
+void SlidingDrMeter::MeanSquares::Resize(const std::size_t num_largest) {
+	while (largest.size() > num_largest) {
+		sum_of_largest -= *largest.begin();
+		others.insert(largest.extract(largest.begin()));
+	}
+	while (largest.size() < num_largest && !others.empty()) {
+		const auto last = std::prev(others.end());
+		sum_of_largest += *last;
+		largest.insert(others.extract(last));
+	}
+}
+
+SlidingDrMeter::TopPeaks SlidingDrMeter::TopPeaks::Merge(const TopPeaks& other) const {
+	if (largest >= other.largest) {
+		return {largest, std::max(second_largest, other.largest)};
+	}
+	return {other.largest, std::max(largest, other.second_largest)};
+}
+
+void SlidingDrMeter::PeakQueue::Push(const float peak) {
+	const TopPeaks top = TopPeaks{peak, kNoPeak}.Merge(back.empty() ? TopPeaks{kNoPeak, kNoPeak} : back.back().second);
+	back.emplace_back(peak, top);
+}
+
+void SlidingDrMeter::PeakQueue::Pop() {
+	if (front.empty()) {
+		while (!back.empty()) {
+			const float peak = back.back().first;
+			back.pop_back();
+			const TopPeaks top = TopPeaks{peak, kNoPeak}.Merge(front.empty() ? TopPeaks{kNoPeak, kNoPeak} : front.back().second);
+			front.emplace_back(peak, top);
+		}
+	}
+	front.pop_back();
+}
+
+SlidingDrMeter::TopPeaks SlidingDrMeter::PeakQueue::Top() const {
+	const TopPeaks none = {kNoPeak, kNoPeak};
+	return (back.empty() ? none : back.back().second).Merge(front.empty() ? none : front.back().second);
+}
+
+}
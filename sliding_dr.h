@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "compute_dr.h"
+
+namespace speedr {
+
+// Rates the last `window_blocks` blocks of a stream of any length, as the
+// blocks come. Adding a block takes time logarithmic in the size of the
+// window, and rating the window takes time linear in the number of channels.
+class SlidingDrMeter {
+public:
+	SlidingDrMeter(int num_channels, std::size_t window_blocks);
+
+	// Appends block `block` of `statistics`, and drops the oldest block if the
+	// window was full.
+	void Push(const BlockStatistics& statistics, std::size_t block);
+	// Same as Rating::FromBlockStatistics on the blocks of the window, up to
+	// the rounding of the sums of mean squares. Needs at least one block.
+	Rating Rate() const;
+
+	std::size_t num_blocks() const { return num_blocks_; }
+
+private:
+	// Splits the mean squares of the window into the largest ones, which the
+	// rating averages, and the others.
+	struct MeanSquares {
+		std::multiset<float> largest;
+		std::multiset<float> others;
+		double sum_of_largest = 0;
+
+		void Insert(float mean_square);
+		void Erase(float mean_square);
+		void Resize(std::size_t num_largest);
+	};
+
+	// The two largest peaks of a sequence of blocks.
+	struct TopPeaks {
+		float largest;
+		float second_largest;
+
+		TopPeaks Merge(const TopPeaks& other) const;
+	};
+
+	// Queue of peaks, kept as two stacks (new blocks are pushed onto one, old
+	// ones popped from the other) each of whose entries also holds the two
+	// largest peaks of the entries below it. Entries are moved from the first
+	// stack to the second when the second one is empty, which keeps the two
+	// largest peaks of the window at hand at an amortized constant cost.
+	struct PeakQueue {
+		std::vector<std::pair<float, TopPeaks>> back;
+		std::vector<std::pair<float, TopPeaks>> front;
+
+		void Push(float peak);
+		void Pop();
+		TopPeaks Top() const;
+	};
+
+	std::size_t window_blocks_;
+	std::size_t num_blocks_ = 0;
+	// For each channel, of the blocks in the window, oldest first.
+	std::vector<std::deque<float>> window_mean_squares_;
+	std::vector<MeanSquares> mean_squares_;
+	std::vector<PeakQueue> peaks_;
+};
+
+}
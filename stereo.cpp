@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stereo.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "compute_dr.h"
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "stereo.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace speedr {
+
+namespace HWY_NAMESPACE {
+namespace {
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+// Adds the sums of L², R² and L·R over `frames` frames of interleaved stereo
+// samples to `sums`. The mid and side energies follow from them, as
+// (L ± R)² = L² + R² ± 2 L·R, so three FMAs per vector of frames suffice.
+HWY_ATTR void AccumulateStereoProducts(const float* HWY_RESTRICT interleaved, const std::size_t frames, double* HWY_RESTRICT sums) {
+	const hn::ScalableTag<float> d;
+	const std::size_t num_lanes = hn::Lanes(d);
+	auto left_squares = hn::Zero(d);
+	auto right_squares = hn::Zero(d);
+	auto products = hn::Zero(d);
+	std::size_t i = 0;
+	for (; i + num_lanes <= frames; i += num_lanes) {
+		hn::VFromD<decltype(d)> left, right;
+		hn::LoadInterleaved2(d, &interleaved[2 * i], left, right);
+		left_squares = hn::MulAdd(left, left, left_squares);
+		right_squares = hn::MulAdd(right, right, right_squares);
+		products = hn::MulAdd(left, right, products);
+	}
+	double left_sum = hn::ReduceSum(d, left_squares);
+	double right_sum = hn::ReduceSum(d, right_squares);
+	double product_sum = hn::ReduceSum(d, products);
+	for (; i < frames; ++i) {
+		const double left = interleaved[2 * i];
+		const double right = interleaved[2 * i + 1];
+		left_sum += left * left;
+		right_sum += right * right;
+		product_sum += left * right;
+	}
+	sums[0] += left_sum;
+	sums[1] += right_sum;
+	sums[2] += product_sum;
+}
+
+}
+}
+
+#if HWY_ONCE
+
+namespace {
+HWY_EXPORT(AccumulateStereoProducts);
+
+// Frames summed in float lanes before the sums are moved to doubles.
+constexpr std::size_t kChunkFrames = 4096;
+}
+
+double StereoMeter::Sums::Correlation() const {
+	return product / std::sqrt(left * right);
+}
+
+double StereoMeter::Sums::SideToMid() const {
+	return 10 * std::log10((left + right - 2 * product) / (left + right + 2 * product));
+}
+
+StereoMeter::StereoMeter(const int samplerate)
+	: block_size_(GetBlockSize(samplerate)) {}
+
+void StereoMeter::Push(const float* interleaved, const std::size_t frames) {
+	std::size_t offset = 0;
+	while (offset < frames) {
+		const std::size_t n = std::min({frames - offset, block_size_ - frames_in_block_, kChunkFrames});
+		double sums[3] = {};
+		HWY_DYNAMIC_DISPATCH(AccumulateStereoProducts)(&interleaved[2 * offset], n, sums);
+		block_.left += sums[0];
+		block_.right += sums[1];
+		block_.product += sums[2];
+		frames_in_block_ += n;
+		offset += n;
+		if (frames_in_block_ == block_size_) {
+			EndBlock();
+		}
+	}
+}
+
+StereoImage StereoMeter::Finish() const {
+	StereoMeter meter = *this;
+	if (meter.frames_in_block_ > 0) {
+		meter.EndBlock();
+	}
+	return {
+		.correlation = meter.track_.Correlation(),
+		.side_to_mid = meter.track_.SideToMid(),
+		.block_correlations = std::move(meter.block_correlations_),
+		.block_side_to_mid = std::move(meter.block_side_to_mid_),
+	};
+}
+
+void StereoMeter::EndBlock() {
+	block_correlations_.push_back(block_.Correlation());
+	block_side_to_mid_.push_back(block_.SideToMid());
+	track_.left += block_.left;
+	track_.right += block_.right;
+	track_.product += block_.product;
+	block_ = Sums();
+	frames_in_block_ = 0;
+}
+
+#endif
+}
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace speedr {
+
+// How the two channels of a stereo track relate. Correlations range from -1
+// (opposite channels, which cancel out when mixed to mono) to 1 (identical
+// channels, i.e. mono presented as stereo), and are NaN for silence.
+struct StereoImage {
+	double correlation;
+	// Energy of the side (L - R) relative to that of the mid (L + R), in dB.
+	double side_to_mid;
+	// Of each block (of GetBlockSize frames, as for DR).
+	std::vector<float> block_correlations;
+	std::vector<float> block_side_to_mid;
+};
+
+// Measures the StereoImage of interleaved stereo samples pushed in chunks of
+// any size, from the sums of L², R² and L·R.
+class StereoMeter {
+public:
+	explicit StereoMeter(int samplerate);
+
+	void Push(const float* interleaved, std::size_t frames);
+	// Including a partial last block.
+	StereoImage Finish() const;
+
+private:
+	// L², R² and L·R, summed over the current block or the whole track.
+	struct Sums {
+		double left = 0;
+		double right = 0;
+		double product = 0;
+
+		double Correlation() const;
+		double SideToMid() const;
+	};
+
+	void EndBlock();
+
+	std::size_t block_size_;
+	std::size_t frames_in_block_ = 0;
+	Sums block_;
+	Sums track_;
+	std::vector<float> block_correlations_;
+	std::vector<float> block_side_to_mid_;
+};
+
+}
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Damages a frame of a FLAC file and checks that decoding it in ranges still
+// gives the same blocks as decoding it whole.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <FLAC/stream_encoder.h>
+
+#include "compute_dr.h"
+#include "flac_dr.h"
+
+namespace {
+
+constexpr unsigned kSamplerate = 44100;
+constexpr unsigned kNumChannels = 2;
+constexpr std::uint64_t kFrames = 30 * kSamplerate;
+
+bool Encode(const std::string& filename) {
+	FLAC__StreamEncoder* const encoder = FLAC__stream_encoder_new();
+	if (!encoder) return false;
+	FLAC__stream_encoder_set_channels(encoder, kNumChannels);
+	FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+	FLAC__stream_encoder_set_sample_rate(encoder, kSamplerate);
+	FLAC__stream_encoder_set_blocksize(encoder, 4096);
+	FLAC__stream_encoder_set_total_samples_estimate(encoder, kFrames);
+	bool ok = FLAC__stream_encoder_init_file(encoder, filename.c_str(), nullptr, nullptr) == FLAC__STREAM_ENCODER_INIT_STATUS_OK;
+	std::vector<FLAC__int32> interleaved(kFrames * kNumChannels);
+	for (std::uint64_t i = 0; i < kFrames; ++i) {
+		// A tone whose level changes every second, so that shifted blocks show.
+		const double level = 0.1 + 0.8 * static_cast<double>(i / kSamplerate % 7) / 6;
+		const double phase = 2 * M_PI * 440 * static_cast<double>(i) / kSamplerate;
+		interleaved[i * kNumChannels] = std::lround(32767 * level * std::sin(phase));
+		interleaved[i * kNumChannels + 1] = std::lround(32767 * level * std::cos(phase));
+	}
+	ok = ok && FLAC__stream_encoder_process_interleaved(encoder, interleaved.data(), kFrames);
+	ok = FLAC__stream_encoder_finish(encoder) && ok;
+	FLAC__stream_encoder_delete(encoder);
+	return ok;
+}
+
+// Overwrites the sync code of the first frame header after `fraction` of the
+// file, so that libFLAC loses sync and drops that frame.
+bool DamageFrame(const std::string& filename, const double fraction) {
+	std::ifstream input(filename, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+	input.close();
+	for (std::size_t i = static_cast<std::size_t>(fraction * bytes.size()); i + 1 < bytes.size(); ++i) {
+		if (static_cast<unsigned char>(bytes[i]) == 0xFF && static_cast<unsigned char>(bytes[i + 1]) == 0xF8) {
+			bytes[i] = bytes[i + 1] = 0;
+			std::ofstream output(filename, std::ios::binary);
+			output.write(bytes.data(), bytes.size());
+			return static_cast<bool>(output);
+		}
+	}
+	return false;
+}
+
+}
+
+int main() {
+	const std::string filename = (std::filesystem::temp_directory_path() / "speedr_flac_dr_test.flac").string();
+	if (!Encode(filename) || !DamageFrame(filename, 0.4)) {
+		std::cerr << "Could not write " << filename << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::optional<speedr::BlockStatistics> whole = speedr::ComputeFlacBlockStatistics(filename);
+	const std::size_t block_size = speedr::GetBlockSize(kSamplerate);
+	const std::size_t num_blocks = (kFrames + block_size - 1) / block_size;
+	int status = EXIT_SUCCESS;
+	if (!whole || whole->mean_square[0].size() != num_blocks) {
+		std::cerr << "Whole file: expected " << num_blocks << " blocks" << std::endl;
+		status = EXIT_FAILURE;
+	}
+	// Neither range boundary falls on the damaged frame.
+	for (const std::size_t num_ranges: {2, 3, 4}) {
+		std::optional<speedr::BlockStatistics> ranges;
+		for (std::size_t i = 0; i < num_ranges; ++i) {
+			std::optional<speedr::BlockStatistics> range = speedr::ComputeFlacBlockStatistics(filename, i * num_blocks / num_ranges * block_size, (i + 1) * num_blocks / num_ranges * block_size);
+			if (!range) break;
+			if (ranges) {
+				ranges->Append(std::move(*range));
+			}
+			else {
+				ranges = std::move(range);
+			}
+		}
+		if (!whole || !ranges || ranges->mean_square != whole->mean_square || ranges->peak != whole->peak) {
+			std::cerr << num_ranges << " ranges: blocks differ from the whole file" << std::endl;
+			status = EXIT_FAILURE;
+		}
+	}
+	std::filesystem::remove(filename);
+	return status;
+}
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "true_peak.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "true_peak.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/aligned_allocator.h>
+#include <hwy/highway.h>
+
+namespace speedr {
+
+namespace HWY_NAMESPACE {
+namespace {
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+constexpr std::size_t kPhases = 4;
+constexpr std::size_t kTaps = 12;
+
+// The 48-tap filter of BS.1770-4, Annex 2, as its four phases.
+constexpr float kInterpolationFilter[kPhases][kTaps] = {
+	{0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f, -0.0594482421875f, 0.1373291015625f, 0.9721679687500f, -0.1022949218750f, 0.0476074218750f, -0.0266113281250f, 0.0148925781250f, -0.0083007812500f},
+	{-0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f, -0.1665039062500f, 0.4650878906250f, 0.7797851562500f, -0.2003173828125f, 0.1015625000000f, -0.0582275390625f, 0.0330810546875f, -0.0189208984375f},
+	{-0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f, -0.2003173828125f, 0.7797851562500f, 0.4650878906250f, -0.1665039062500f, 0.0891113281250f, -0.0517578125000f, 0.0292968750000f, -0.0291748046875f},
+	{-0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f, -0.1022949218750f, 0.9721679687500f, 0.1373291015625f, -0.0594482421875f, 0.0332031250000f, -0.0196533203125f, 0.0109863281250f, 0.0017089843750f},
+};
+
+std::size_t NumLanes() {
+	return hn::Lanes(hn::ScalableTag<float>());
+}
+
+// Returns the larger of `peak` and of the absolute values of the four
+// interpolated samples that each of the `count` samples from `samples` starts.
+// The kTaps - 1 samples before them must be readable, and so must a vector
+// after them. Consecutive output samples of a phase fill the lanes, so that
+// each tap costs one unaligned load shared by the four phases.
+HWY_ATTR float GetInterpolatedPeak(const float* HWY_RESTRICT samples, const std::size_t count, const float peak) {
+	const hn::ScalableTag<float> d;
+	const std::size_t num_lanes = hn::Lanes(d);
+	auto peaks = hn::Set(d, peak);
+	for (std::size_t i = 0; i < count; i += num_lanes) {
+		auto phase0 = hn::Zero(d);
+		auto phase1 = hn::Zero(d);
+		auto phase2 = hn::Zero(d);
+		auto phase3 = hn::Zero(d);
+		for (std::size_t tap = 0; tap < kTaps; ++tap) {
+			const auto x = hn::LoadU(d, &samples[i] - tap);
+			phase0 = hn::MulAdd(hn::Set(d, kInterpolationFilter[0][tap]), x, phase0);
+			phase1 = hn::MulAdd(hn::Set(d, kInterpolationFilter[1][tap]), x, phase1);
+			phase2 = hn::MulAdd(hn::Set(d, kInterpolationFilter[2][tap]), x, phase2);
+			phase3 = hn::MulAdd(hn::Set(d, kInterpolationFilter[3][tap]), x, phase3);
+		}
+		const auto largest = hn::Max(hn::Max(hn::Abs(phase0), hn::Abs(phase1)), hn::Max(hn::Abs(phase2), hn::Abs(phase3)));
+		// Lanes past the end were fed whatever follows the samples.
+		peaks = hn::Max(peaks, hn::IfThenElseZero(hn::FirstN(d, count - i), largest));
+	}
+	return hn::ReduceMax(d, peaks);
+}
+
+// Copies `frames` frames of interleaved stereo samples to `left` and `right`.
+HWY_ATTR void DeinterleaveStereo(const float* HWY_RESTRICT interleaved, const std::size_t frames, float* HWY_RESTRICT left, float* HWY_RESTRICT right) {
+	const hn::ScalableTag<float> d;
+	const std::size_t num_lanes = hn::Lanes(d);
+	std::size_t i = 0;
+	for (; i + num_lanes <= frames; i += num_lanes) {
+		hn::VFromD<decltype(d)> left_samples, right_samples;
+		hn::LoadInterleaved2(d, &interleaved[2 * i], left_samples, right_samples);
+		hn::StoreU(left_samples, d, &left[i]);
+		hn::StoreU(right_samples, d, &right[i]);
+	}
+	for (; i < frames; ++i) {
+		left[i] = interleaved[2 * i];
+		right[i] = interleaved[2 * i + 1];
+	}
+}
+
+}
+}
+
+#if HWY_ONCE
+
+namespace {
+HWY_EXPORT(NumLanes);
+HWY_EXPORT(GetInterpolatedPeak);
+HWY_EXPORT(DeinterleaveStereo);
+
+// Samples before the current one that the interpolation filter spans.
+constexpr std::size_t kHistory = 11;
+constexpr std::size_t kChunkFrames = 4096;
+}
+
+TruePeakMeter::TruePeakMeter(const int num_channels)
+	: num_channels_(num_channels),
+	  peaks_(num_channels) {
+	const std::size_t size = kHistory + kChunkFrames + HWY_DYNAMIC_DISPATCH(NumLanes)();
+	for (int c = 0; c < num_channels; ++c) {
+		samples_.push_back(hwy::AllocateAligned<float>(size));
+		std::fill_n(samples_.back().get(), size, 0.f);
+	}
+}
+
+void TruePeakMeter::Push(const float* interleaved, const std::size_t frames) {
+	for (std::size_t offset = 0; offset < frames; offset += kChunkFrames) {
+		const std::size_t n = std::min(frames - offset, kChunkFrames);
+		if (num_channels_ == 2) {
+			HWY_DYNAMIC_DISPATCH(DeinterleaveStereo)(&interleaved[2 * offset], n, &samples_[0][kHistory], &samples_[1][kHistory]);
+		}
+		else {
+			for (int c = 0; c < num_channels_; ++c) {
+				for (std::size_t i = 0; i < n; ++i) {
+					samples_[c][kHistory + i] = interleaved[(offset + i) * num_channels_ + c];
+				}
+			}
+		}
+		for (int c = 0; c < num_channels_; ++c) {
+			float* const samples = samples_[c].get();
+			peaks_[c] = HWY_DYNAMIC_DISPATCH(GetInterpolatedPeak)(&samples[kHistory], n, peaks_[c]);
+			std::memmove(samples, &samples[n], kHistory * sizeof *samples);
+		}
+	}
+}
+
+double TruePeakMeter::Finish() const {
+	const float peak = peaks_.empty() ? 0.f : *std::max_element(peaks_.begin(), peaks_.end());
+	if (peak == 0) return -std::numeric_limits<double>::infinity();
+	return 20 * std::log10(static_cast<double>(peak));
+}
+
+#endif
+}
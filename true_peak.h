@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2026 Sami Boukortt
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <hwy/aligned_allocator.h>
+
+namespace speedr {
+
+// Measures the true peak of interleaved samples pushed in chunks of any size,
+// as the highest absolute value of the signal upsampled four times with the
+// interpolation filter of ITU-R BS.1770-4, which catches the peaks that fall
+// between samples.
+class TruePeakMeter {
+public:
+	explicit TruePeakMeter(int num_channels);
+
+	void Push(const float* interleaved, std::size_t frames);
+	// In dBTP, of the loudest channel, or -infinity for silence.
+	double Finish() const;
+
+private:
+	int num_channels_;
+	// For each channel, the last samples of the previous push, which the
+	// filter still spans, followed by room for a chunk of new ones.
+	std::vector<hwy::AlignedFreeUniquePtr<float[]>> samples_;
+	std::vector<float> peaks_;
+};
+
+}